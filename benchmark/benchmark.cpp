@@ -0,0 +1,300 @@
+#include "city_generator.h"
+#include "json.h"
+#include "json_builder.h"
+#include "json_reader.h"
+#include "map_renderer.h"
+#include "request_handler.h"
+#include "svg.h"
+#include "transport_catalogue.h"
+#include "transport_router.h"
+
+#include <algorithm>
+#include <charconv>
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+#include <optional>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+/*
+ * Бенчмарк фаз работы справочника на синтетическом городе из city_generator.
+ * Каждая фаза повторяется --repeat раз на новых данных, выводятся минимальное
+ * и среднее время в миллисекундах. После фаз программы отдельно измеряются
+ * разбор и вывод json на городе с плотной сетью road_distances, построение
+ * ответов через json::Builder и вывод большого документа svg.
+ *
+ * Ключи командной строки:
+ *   --city PARAMS  параметры города в формате --generate, например stops=300,buses=60
+ *   --threads N    потоков для ответов на stat_requests и отрисовки карты (0 - по числу ядер)
+ *   --repeat N     число повторов, по умолчанию 3
+ */
+
+using namespace std::literals;
+
+namespace {
+
+    using Clock = std::chrono::steady_clock;
+
+    struct Options {
+        city_generator::CityParams city;
+        size_t thread_count = 1;
+        int repeat = 3;
+    };
+
+    // Времена одной фазы по всем повторам
+    struct Phase {
+        std::string_view name;
+        std::vector<double> milliseconds;
+    };
+
+    class Timings {
+    public:
+        // Выполняет action и добавляет его время к фазе name
+        template <typename Action>
+        void Measure(std::string_view name, Action&& action) {
+            const auto start = Clock::now();
+            action();
+            const std::chrono::duration<double, std::milli> duration = Clock::now() - start;
+            FindPhase(name).milliseconds.push_back(duration.count());
+        }
+
+        void Print(std::ostream& output) const {
+            const auto flags = output.flags();
+            const auto precision = output.precision();
+            output << std::fixed << std::setprecision(2);
+            output << std::left << std::setw(16) << "phase"sv << std::right
+                << std::setw(12) << "min_ms"sv << std::setw(12) << "mean_ms"sv << '\n';
+            for (const Phase& phase : phases_) {
+                double total = 0.0;
+                for (const double milliseconds : phase.milliseconds) {
+                    total += milliseconds;
+                }
+                output << std::left << std::setw(16) << phase.name << std::right
+                    << std::setw(12) << *std::min_element(phase.milliseconds.begin(), phase.milliseconds.end())
+                    << std::setw(12) << total / static_cast<double>(phase.milliseconds.size()) << '\n';
+            }
+            output.flags(flags);
+            output.precision(precision);
+        }
+
+    private:
+        Phase& FindPhase(std::string_view name) {
+            const auto it = std::find_if(phases_.begin(), phases_.end(), [name](const Phase& phase) {
+                return phase.name == name;
+                });
+            return it != phases_.end() ? *it : phases_.emplace_back(Phase{ name, {} });
+        }
+
+        // Фазы в порядке первого выполнения
+        std::vector<Phase> phases_;
+    };
+
+    size_t ParseCount(std::string_view value) {
+        size_t count = 0;
+        const auto [ptr, ec] = std::from_chars(value.data(), value.data() + value.size(), count);
+        if (ec != std::errc{} || ptr != value.data() + value.size()) {
+            throw std::invalid_argument("Invalid count: "s + std::string(value));
+        }
+        return count;
+    }
+
+    Options ParseOptions(int argc, char* argv[]) {
+        Options options;
+        options.city = city_generator::ParseCityParams("stops=300,buses=60,min_route=10,max_route=30,"
+            "bus_requests=1000,stop_requests=1000,route_requests=3000,map_requests=1"sv);
+        for (int i = 1; i < argc; ++i) {
+            const std::string_view arg = argv[i];
+            if (arg == "--city"sv && i + 1 < argc) {
+                options.city = city_generator::ParseCityParams(argv[++i]);
+            }
+            else if (arg == "--threads"sv && i + 1 < argc) {
+                options.thread_count = ParseCount(argv[++i]);
+                if (options.thread_count == 0) {
+                    options.thread_count = std::max(1u, std::thread::hardware_concurrency());
+                }
+            }
+            else if (arg == "--repeat"sv && i + 1 < argc) {
+                options.repeat = static_cast<int>(std::max<size_t>(ParseCount(argv[++i]), 1));
+            }
+            else {
+                throw std::invalid_argument("Unknown option: "s + std::string(arg));
+            }
+        }
+        return options;
+    }
+
+    // Один проход: разбор, загрузка справочника, построение графа маршрутов,
+    // ответы на stat_requests и отдельно отрисовка всей карты
+    void RunPipeline(const std::string& document, const Options& options, Timings& timings) {
+        {
+            // Путь программы по умолчанию: записи загружаются в справочник при разборе
+            transport_catalogue::TransportCatalogue catalogue;
+            std::istringstream input(document);
+            timings.Measure("stream load"sv, [&] {
+                json_reader::JsonReader(catalogue, input, json_reader::LoadMode::STREAMING);
+                });
+        }
+
+        transport_catalogue::TransportCatalogue catalogue;
+        std::istringstream input(document);
+        std::optional<json_reader::JsonReader> reader;
+        timings.Measure("parse"sv, [&] {
+            reader.emplace(catalogue, input, json_reader::LoadMode::DOCUMENT);
+            });
+        timings.Measure("load"sv, [&] {
+            reader->LoadDataToCatalogue();
+            });
+
+        const renderer::MapRenderer renderer = reader->LoadRenderSettings();
+        std::optional<transport_catalogue::Router> router;
+        timings.Measure("route graph"sv, [&] {
+            router.emplace(reader->LoadRoutingSettings(), catalogue);
+            });
+
+        std::ostringstream answers;
+        request_handler::HandlerOptions handler_options;
+        handler_options.thread_count = options.thread_count;
+        handler_options.output = &answers;
+        timings.Measure("stat answers"sv, [&] {
+            request_handler::RequestHandler(catalogue, renderer, *reader, *router, handler_options);
+            });
+
+        std::ostringstream map;
+        timings.Measure("render"sv, [&] {
+            renderer.RenderSVG(catalogue.GetSortedBuses(), map, options.thread_count);
+            });
+    }
+
+    // Город для замеров json: только base_requests с плотными road_distances,
+    // поэтому большая часть лексем - координаты и расстояния
+    constexpr std::string_view JSON_CITY = "stops=5000,buses=200,density=8,"
+        "bus_requests=0,stop_requests=0,route_requests=0,map_requests=0"sv;
+
+    std::string GenerateDocument(const city_generator::CityParams& params) {
+        std::ostringstream document;
+        city_generator::GenerateCity(params, document);
+        return document.str();
+    }
+
+    // Разбор и вывод документа json без справочника
+    void RunJsonBenchmark(const std::string& document, Timings& timings) {
+        std::optional<json::Document> parsed;
+        timings.Measure("json load"sv, [&] {
+            parsed.emplace(json::Load(document));
+            });
+        std::ostringstream output;
+        timings.Measure("json print"sv, [&] {
+            json::Print(*parsed, output);
+            });
+    }
+
+    // Ответ в форме PrintRoute: словарь с массивом items из 50 словарей
+    json::Node BuildRouteAnswer(int id) {
+        json::Builder builder;
+        builder.StartDict()
+            .Key("request_id"s).Value(id)
+            .Key("total_time"s).Value(id * 1.5)
+            .Key("items"s).StartArray();
+        for (int item = 0; item < 50; ++item) {
+            if (item % 2 == 0) {
+                builder.StartDict()
+                    .Key("type"s).Value("Wait"s)
+                    .Key("stop_name"s).Value("Stop "s + std::to_string(item))
+                    .Key("time"s).Value(6)
+                    .EndDict();
+            }
+            else {
+                builder.StartDict()
+                    .Key("type"s).Value("Bus"s)
+                    .Key("bus"s).Value("Bus "s + std::to_string(item))
+                    .Key("span_count"s).Value(item % 7 + 1)
+                    .Key("time"s).Value(item * 0.75)
+                    .EndDict();
+            }
+        }
+        builder.EndArray().EndDict();
+        return builder.Build();
+    }
+
+    void RunBuilderBenchmark(Timings& timings) {
+        constexpr int ANSWER_COUNT = 2000;
+        std::vector<json::Node> answers;
+        answers.reserve(ANSWER_COUNT);
+        timings.Measure("json build"sv, [&] {
+            for (int id = 0; id < ANSWER_COUNT; ++id) {
+                answers.push_back(BuildRouteAnswer(id));
+            }
+            });
+    }
+
+
+    // Документ svg из объектов, которые рисует карта: 200 ломаных по 1000 точек,
+    // 5000 кругов и 5000 надписей. Координаты дробные, как после проекции
+    svg::Document MakeSvgDocument() {
+        constexpr double GOLDEN_RATIO = 0.6180339887498949;
+        double fraction = 0.0;
+        const auto next_point = [&fraction] {
+            fraction += GOLDEN_RATIO;
+            fraction -= static_cast<int>(fraction);
+            const double x = 50.0 + 1100.0 * fraction;
+            fraction += GOLDEN_RATIO;
+            fraction -= static_cast<int>(fraction);
+            return svg::Point{ x, 50.0 + 700.0 * fraction };
+        };
+
+        svg::Document document;
+        for (int line = 0; line < 200; ++line) {
+            svg::Polyline polyline;
+            polyline.SetStrokeWidth(14.0).SetStrokeColor("green"s).SetFillColor(svg::NoneColor);
+            for (int point = 0; point < 1000; ++point) {
+                polyline.AddPoint(next_point());
+            }
+            document.Add(std::move(polyline));
+        }
+        for (int stop = 0; stop < 5000; ++stop) {
+            document.Add(svg::Circle().SetCenter(next_point()).SetRadius(5.0).SetFillColor("white"s));
+            document.Add(svg::Text().SetPosition(next_point()).SetOffset({ 7.0, -3.0 }).SetFontSize(18)
+                .SetFontFamily("Verdana"s).SetData("Stop "s + std::to_string(stop)).SetFillColor("black"s));
+        }
+        return document;
+    }
+
+    void RunSvgBenchmark(Timings& timings) {
+        const svg::Document document = MakeSvgDocument();
+        std::ostringstream output;
+        timings.Measure("svg render"sv, [&] {
+            document.Render(output);
+            });
+    }
+
+}  // namespace
+
+int main(int argc, char* argv[]) {
+    Options options;
+    try {
+        options = ParseOptions(argc, argv);
+    }
+    catch (const std::invalid_argument& e) {
+        std::cerr << e.what() << std::endl;
+        return 1;
+    }
+
+    const std::string text = GenerateDocument(options.city);
+    const std::string json_text = GenerateDocument(city_generator::ParseCityParams(JSON_CITY));
+    std::cout << "city: "sv << options.city.stop_count << " stops, "sv << options.city.bus_count << " buses, "sv
+        << text.size() << " bytes, "sv << options.thread_count << " thread(s)\n"sv;
+
+    Timings timings;
+    for (int run = 0; run < options.repeat; ++run) {
+        RunPipeline(text, options, timings);
+        RunJsonBenchmark(json_text, timings);
+        RunBuilderBenchmark(timings);
+        RunSvgBenchmark(timings);
+    }
+    timings.Print(std::cout);
+}
@@ -0,0 +1,230 @@
+#include "test_utils.h"
+
+#include "json.h"
+#include "json_reader.h"
+#include "transport_catalogue.h"
+
+#include <algorithm>
+#include <memory_resource>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+
+using namespace std::literals;
+
+namespace {
+
+    const json_reader::LoadMode ALL_MODES[] = {
+        json_reader::LoadMode::DOCUMENT,
+        json_reader::LoadMode::STREAMING,
+        json_reader::LoadMode::PARALLEL,
+    };
+
+    const std::string VALID_STOP = R"({"type": "Stop", "name": "A", "latitude": 55.6, "longitude": 37.6, "road_distances": {"B": 100}})"s;
+    const std::string VALID_BUS = R"({"type": "Bus", "name": "1", "stops": ["A", "B"], "is_roundtrip": false})"s;
+    const std::string VALID_RENDER_SETTINGS = R"({
+        "width": 600, "height": 400, "padding": 50, "line_width": 14, "stop_radius": 5,
+        "bus_label_font_size": 20, "bus_label_offset": [7, 15],
+        "stop_label_font_size": 18, "stop_label_offset": [7, -3],
+        "underlayer_color": "white", "underlayer_width": 3, "color_palette": ["green"]})"s;
+
+    std::string MakeDocument(const std::string& base_request, const std::string& stat_request,
+        const std::string& render_settings = VALID_RENDER_SETTINGS,
+        const std::string& routing_settings = R"({"bus_wait_time": 6, "bus_velocity": 40})"s) {
+        return R"({"base_requests": [)"s + VALID_STOP + ","s
+            + R"({"type": "Stop", "name": "B", "latitude": 55.7, "longitude": 37.7, "road_distances": {}},)"s
+            + base_request + R"(], "render_settings": )"s + render_settings
+            + R"(, "routing_settings": )"s + routing_settings
+            + R"(, "stat_requests": [)"s + stat_request + "]}"s;
+    }
+
+    // Тип и текст исключения, выброшенного при загрузке, или пустая строка
+    std::string LoadError(const std::string& document, json_reader::LoadMode mode) {
+        try {
+            transport_catalogue::TransportCatalogue catalogue;
+            std::istringstream input(document);
+            json_reader::JsonReader reader(catalogue, input, mode);
+            reader.LoadDataToCatalogue();
+            return {};
+        }
+        catch (const json::ParsingError& e) {
+            return "json::ParsingError: "s + e.what();
+        }
+        catch (const std::out_of_range& e) {
+            return "std::out_of_range: "s + e.what();
+        }
+        catch (const std::exception& e) {
+            return "std::exception: "s + e.what();
+        }
+    }
+
+    // Все режимы загрузки ведут себя одинаково, и результат совпадает с expected_prefix
+    void AssertSameError(const std::string& document, std::string_view expected_prefix) {
+        const std::string expected = LoadError(document, json_reader::LoadMode::DOCUMENT);
+        ASSERT_HINT(expected.substr(0, expected_prefix.size()) == expected_prefix, expected);
+        for (const auto mode : ALL_MODES) {
+            ASSERT_HINT(LoadError(document, mode) == expected, LoadError(document, mode) + " vs "s + expected);
+        }
+    }
+
+    void TestValidDocument() {
+        AssertSameError(MakeDocument(VALID_BUS, R"({"id": 1, "type": "Map", "tile": {"z": 0, "x": 0, "y": 0}})"s), ""sv);
+    }
+
+    void TestMissingRequiredKeys() {
+        AssertSameError(MakeDocument(R"({"type": "Stop", "name": "C", "longitude": 37.6, "road_distances": {}})"s, ""s),
+            "std::out_of_range: Key 'latitude' not found"sv);
+        AssertSameError(MakeDocument(R"({"type": "Stop", "name": "C", "latitude": 55.6, "longitude": 37.6})"s, ""s),
+            "std::out_of_range: Key 'road_distances' not found"sv);
+        AssertSameError(MakeDocument(R"({"type": "Bus", "stops": ["A"], "is_roundtrip": true})"s, ""s),
+            "std::out_of_range: Key 'name' not found"sv);
+        AssertSameError(MakeDocument(R"({"type": "Bus", "name": "2", "stops": ["A"]})"s, ""s),
+            "std::out_of_range: Key 'is_roundtrip' not found"sv);
+        AssertSameError(MakeDocument(VALID_BUS, R"({"type": "Bus", "name": "1"})"s),
+            "std::out_of_range: Key 'id' not found"sv);
+        AssertSameError(MakeDocument(VALID_BUS, R"({"id": 1, "type": "Route", "from": "A"})"s),
+            "std::out_of_range: Key 'to' not found"sv);
+        AssertSameError(MakeDocument(VALID_BUS, ""s, R"({"width": 600})"s),
+            "std::out_of_range: Key 'height' not found"sv);
+        AssertSameError(MakeDocument(VALID_BUS, ""s, VALID_RENDER_SETTINGS, R"({"bus_wait_time": 6})"s),
+            "std::out_of_range: Key 'bus_velocity' not found"sv);
+    }
+
+    void TestOptionalKeys() {
+        // Ключи, не нужные записи этого типа, необязательны
+        AssertSameError(MakeDocument(R"({"type": "Tram", "name": "T"})"s, R"({"id": 1, "type": "Map"})"s), ""sv);
+        AssertSameError(MakeDocument(VALID_BUS, R"({"id": 1, "type": "Bogus"})"s), ""sv);
+    }
+
+    void TestDuplicateKeys() {
+        AssertSameError(MakeDocument(R"({"type": "Bus", "name": "2", "name": "3", "stops": ["A"], "is_roundtrip": true})"s, ""s),
+            "json::ParsingError: Duplicate key 'name'"sv);
+        AssertSameError(MakeDocument(VALID_BUS, R"({"id": 1, "id": 2, "type": "Map"})"s),
+            "json::ParsingError: Duplicate key 'id'"sv);
+        AssertSameError(MakeDocument(VALID_BUS, R"({"id": 1, "type": "Map", "comment": "a", "comment": "b"})"s),
+            "json::ParsingError: Duplicate key 'comment'"sv);
+        AssertSameError(MakeDocument(R"({"type": "Stop", "name": "C", "latitude": 55.6, "longitude": 37.6, "road_distances": {"A": 1, "A": 2}})"s, ""s),
+            "json::ParsingError: Duplicate key 'A'"sv);
+        AssertSameError(MakeDocument(VALID_BUS, ""s, VALID_RENDER_SETTINGS, R"({"bus_wait_time": 6, "bus_velocity": 40, "bus_velocity": 50})"s),
+            "json::ParsingError: Duplicate key 'bus_velocity'"sv);
+    }
+
+    void TestSkippedValues() {
+        // Значения неизвестных ключей пропускаются, но проверяются так же, как в документе
+        const std::string stop_prefix = R"({"type": "Stop", "name": "C", "latitude": 55.6, "longitude": 37.6, "road_distances": {}, "extra": )"s;
+        AssertSameError(MakeDocument(stop_prefix + R"({"a": [1, {"b": null, "c": "\n"}], "d": -1.5e3, "e": true}})"s, ""s), ""sv);
+        AssertSameError(MakeDocument(stop_prefix + R"({"a": {"b": 1, "b": 2}}})"s, ""s),
+            "json::ParsingError: Duplicate key 'b'"sv);
+        AssertSameError(MakeDocument(stop_prefix + R"([1, -]})"s, ""s), "json::ParsingError: A digit is expected"sv);
+        AssertSameError(MakeDocument(stop_prefix + R"({"a" 1}})"s, ""s), "json::ParsingError"sv);
+        AssertSameError(MakeDocument(stop_prefix + R"(tru})"s, ""s), "json::ParsingError: Failed to parse 'tru'"sv);
+        AssertSameError(MakeDocument(stop_prefix + R"(1e99999})"s, ""s), "json::ParsingError: Failed to convert"sv);
+        AssertSameError(MakeDocument(stop_prefix + R"("\q"})"s, ""s), "json::ParsingError: Unrecognized escape"sv);
+        std::string many_keys = "{"s;
+        for (int key = 0; key < 40; ++key) {
+            many_keys += "\"k"s + std::to_string(key % 30) + "\": "s + std::to_string(key) + (key + 1 < 40 ? ","s : "}"s);
+        }
+        AssertSameError(MakeDocument(stop_prefix + many_keys + "}"s, ""s), "json::ParsingError: Duplicate key 'k0'"sv);
+        // tile при заданном bbox тоже только пропускается
+        AssertSameError(MakeDocument(VALID_BUS, R"({"id": 1, "type": "Map", "bbox": {"min_lat": 55, "min_lng": 37, "max_lat": 56, "max_lng": 38}, "tile": {"z": 1, "z": 2}})"s),
+            "json::ParsingError: Duplicate key 'z'"sv);
+    }
+
+    void TestTypedValues() {
+        // Числа и литералы читаются без узлов, но значение не того типа даёт те же ошибки
+        AssertSameError(MakeDocument(R"({"type": "Stop", "name": "C", "latitude": "55.6", "longitude": 37.6, "road_distances": {}})"s, ""s),
+            "std::exception: Not a double"sv);
+        AssertSameError(MakeDocument(R"({"type": "Stop", "name": "C", "latitude": 55, "longitude": 37.6, "road_distances": {"A": 1.5}})"s, ""s),
+            "std::exception: Not an int"sv);
+        AssertSameError(MakeDocument(VALID_BUS, R"({"id": 3000000000, "type": "Map"})"s),
+            "std::exception: Not an int"sv);
+        AssertSameError(MakeDocument(VALID_BUS, R"({"id": -7, "type": "Map"})"s), ""sv);
+        AssertSameError(MakeDocument(R"({"type": "Bus", "name": "2", "stops": ["A"], "is_roundtrip": 1})"s, ""s),
+            "std::exception: Not a bool"sv);
+        AssertSameError(MakeDocument(R"({"type": "Bus", "name": "2", "stops": ["A"], "is_roundtrip": fals})"s, ""s),
+            "json::ParsingError: Failed to parse 'fals'"sv);
+        // Ошибка посреди значения, читаемого в узел временной арены
+        std::string bad_color = VALID_RENDER_SETTINGS;
+        bad_color.replace(bad_color.find(R"("white")"s), 7, R"([255, [1, {"a": "b", "c": ]]])"s);
+        AssertSameError(MakeDocument(VALID_BUS, ""s, bad_color), "json::ParsingError: A digit is expected"sv);
+        AssertSameError(MakeDocument(VALID_BUS, ""s, VALID_RENDER_SETTINGS, R"({"bus_wait_time": 6, "bus_velocity": -})"s),
+            "json::ParsingError: A digit is expected"sv);
+    }
+
+    // Считает память, взятую через ресурс по умолчанию. Из него получают блоки
+    // арена документа и временные арены потоковой загрузки
+    class CountingResource : public std::pmr::memory_resource {
+    public:
+        size_t Peak() const {
+            return peak_;
+        }
+
+    private:
+        void* do_allocate(size_t bytes, size_t alignment) override {
+            current_ += bytes;
+            peak_ = std::max(peak_, current_);
+            return std::pmr::new_delete_resource()->allocate(bytes, alignment);
+        }
+
+        void do_deallocate(void* p, size_t bytes, size_t alignment) override {
+            current_ -= bytes;
+            std::pmr::new_delete_resource()->deallocate(p, bytes, alignment);
+        }
+
+        bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override {
+            return this == &other;
+        }
+
+        size_t current_ = 0;
+        size_t peak_ = 0;
+    };
+
+    // Наибольший объём арен при потоковой загрузке stop_count остановок,
+    // у каждой из которых есть значения, читаемые через узлы или пропускаемые
+    size_t StreamingArenaPeak(int stop_count) {
+        std::string base_requests;
+        std::string stat_requests;
+        for (int stop = 0; stop < stop_count; ++stop) {
+            const std::string separator = stop > 0 ? ","s : ""s;
+            base_requests += separator + R"({"type": "Stop", "name": "S)"s + std::to_string(stop)
+                + R"(", "latitude": 55.6, "longitude": 37.6, "road_distances": {},)"s
+                + R"( "comment": {"tags": ["first tag", "second tag"], "note": "a value of an unknown key"}})"s;
+            stat_requests += separator + R"({"id": )"s + std::to_string(stop)
+                + R"(, "type": "Map", "bbox": {"min_lat": 55, "min_lng": 37, "max_lat": 56, "max_lng": 38}, "tile": {"z": 0, "x": 0, "y": 0}})"s;
+        }
+        const std::string document = R"({"base_requests": [)"s + base_requests + R"(], "render_settings": )"s
+            + VALID_RENDER_SETTINGS + R"(, "stat_requests": [)"s + stat_requests + "]}"s;
+
+        CountingResource counting;
+        std::pmr::memory_resource* previous = std::pmr::set_default_resource(&counting);
+        {
+            transport_catalogue::TransportCatalogue catalogue;
+            std::istringstream input(document);
+            json_reader::JsonReader reader(catalogue, input, json_reader::LoadMode::STREAMING);
+            reader.LoadDataToCatalogue();
+        }
+        std::pmr::set_default_resource(previous);
+        return counting.Peak();
+    }
+
+    void TestStreamingMemoryIsBounded() {
+        // Прочитанные и пропущенные значения не накапливаются в арене документа
+        const size_t small = StreamingArenaPeak(10);
+        const size_t large = StreamingArenaPeak(2000);
+        ASSERT_HINT(large <= small, std::to_string(small) + " bytes for 10 records, "s
+            + std::to_string(large) + " bytes for 2000 records"s);
+    }
+
+}  // namespace
+
+int main() {
+    int failures = 0;
+    RUN_TEST(failures, TestValidDocument);
+    RUN_TEST(failures, TestMissingRequiredKeys);
+    RUN_TEST(failures, TestOptionalKeys);
+    RUN_TEST(failures, TestDuplicateKeys);
+    RUN_TEST(failures, TestSkippedValues);
+    RUN_TEST(failures, TestTypedValues);
+    RUN_TEST(failures, TestStreamingMemoryIsBounded);
+    return failures;
+}
@@ -0,0 +1,131 @@
+#include "test_utils.h"
+
+#include "map_renderer.h"
+#include "transport_catalogue.h"
+
+#include <sstream>
+#include <string>
+#include <vector>
+
+using namespace std::literals;
+
+namespace {
+
+    renderer::RenderSettings MakeSettings() {
+        renderer::RenderSettings settings;
+        settings.width = 600.0;
+        settings.height = 400.0;
+        settings.padding = 50.0;
+        settings.line_width = 14.0;
+        settings.stop_radius = 5.0;
+        settings.bus_label_font_size = 20;
+        settings.bus_label_offset = { 7.0, 15.0 };
+        settings.stop_label_font_size = 18;
+        settings.stop_label_offset = { 7.0, -3.0 };
+        settings.underlayer_color = svg::Rgba{ 255, 255, 255, 0.85 };
+        settings.underlayer_width = 3.0;
+        settings.color_palette = { "green"s, svg::Rgb{ 255, 160, 0 }, "red"s };
+        return settings;
+    }
+
+    // Остановки на сетке внутри [55.5, 55.7] x [37.5, 37.7] и маршруты между ними
+    void FillCatalogue(transport_catalogue::TransportCatalogue& catalogue) {
+        for (int stop = 0; stop < 16; ++stop) {
+            catalogue.AddStop("Stop "s + std::to_string(stop), { 55.5 + 0.2 * (stop / 4) / 3.0, 37.5 + 0.2 * (stop % 4) / 3.0 });
+        }
+        for (int bus = 0; bus < 6; ++bus) {
+            const std::string stops[] = {
+                "Stop "s + std::to_string(bus),
+                "Stop "s + std::to_string(bus + 5),
+                "Stop "s + std::to_string(bus + 10),
+            };
+            catalogue.AddBus("Bus "s + std::to_string(bus * 2), { stops[0], stops[1], stops[2] }, bus % 2 == 0);
+        }
+    }
+
+    std::string RenderFull(const renderer::MapRenderer& renderer, const transport_catalogue::TransportCatalogue& catalogue,
+        size_t thread_count = 1) {
+        std::ostringstream out;
+        renderer.RenderSVG(catalogue.GetSortedBuses(), out, thread_count);
+        return out.str();
+    }
+
+    std::string RenderIncremental(const renderer::MapRenderer& renderer, const transport_catalogue::TransportCatalogue& catalogue,
+        size_t thread_count) {
+        std::ostringstream out;
+        renderer.RenderSVG(catalogue.GetSortedBuses(), catalogue.GetVersion(), out, thread_count);
+        return out.str();
+    }
+
+    void TestParallelRenderMatchesSequential() {
+        transport_catalogue::TransportCatalogue catalogue;
+        FillCatalogue(catalogue);
+        const renderer::MapRenderer renderer(MakeSettings());
+
+        std::ostringstream document;
+        renderer.GetSVGDocument(catalogue.GetSortedBuses()).Render(document);
+        ASSERT(RenderFull(renderer, catalogue) == document.str());
+        for (const size_t thread_count : { 2, 3, 16 }) {
+            ASSERT_HINT(RenderFull(renderer, catalogue, thread_count) == document.str(), std::to_string(thread_count) + " threads"s);
+        }
+    }
+
+    void TestIncrementalRenderMatchesFullRender() {
+        for (const size_t thread_count : { 1, 3 }) {
+            transport_catalogue::TransportCatalogue catalogue;
+            FillCatalogue(catalogue);
+            const renderer::MapRenderer renderer(MakeSettings());
+            const auto check = [&](std::string_view step) {
+                ASSERT_HINT(RenderIncremental(renderer, catalogue, thread_count) == RenderFull(renderer, catalogue), step);
+            };
+
+            check("first render"sv);
+            check("same version"sv);
+
+            // Новая остановка и маршрут внутри прежних границ: проекция не меняется
+            catalogue.AddStop("Inner"s, { 55.55, 37.55 });
+            catalogue.AddBus("Bus 99"s, { "Inner"sv, "Stop 3"sv }, false);
+            check("stop and bus at the end of the order"sv);
+
+            // Маршрут в начале порядка названий сдвигает цвета всех остальных
+            catalogue.AddBus("Bus 01"s, { "Inner"sv, "Stop 7"sv }, false);
+            check("bus at the start of the order"sv);
+
+            // Остановка без маршрутов на карту не попадает
+            catalogue.AddStop("Lonely"s, { 56.0, 38.0 });
+            check("stop without buses"sv);
+
+            // Остановка за прежними границами меняет проекцию всей карты
+            catalogue.AddStop("Outer"s, { 55.9, 37.9 });
+            catalogue.AddBus("Bus 50"s, { "Outer"sv, "Stop 0"sv }, true);
+            check("stop outside the map"sv);
+
+            catalogue.AddStopDistance("Stop 0"s, "Stop 1"s, 100);
+            check("distance only"sv);
+        }
+    }
+
+    void TestEmptyPalette() {
+        transport_catalogue::TransportCatalogue catalogue;
+        FillCatalogue(catalogue);
+        renderer::RenderSettings settings = MakeSettings();
+        settings.color_palette.clear();
+        const renderer::MapRenderer renderer(settings);
+
+        const std::string full = RenderFull(renderer, catalogue);
+        ASSERT(full.find("stroke=\"none\""s) != std::string::npos);
+        ASSERT(RenderFull(renderer, catalogue, 3) == full);
+        ASSERT(RenderIncremental(renderer, catalogue, 1) == full);
+        catalogue.AddBus("Bus 01"s, { "Stop 1"sv, "Stop 7"sv }, false);
+        ASSERT(RenderIncremental(renderer, catalogue, 3) == RenderFull(renderer, catalogue));
+    }
+
+}  // namespace
+
+int main() {
+    int failures = 0;
+    RUN_TEST(failures, TestParallelRenderMatchesSequential);
+    RUN_TEST(failures, TestIncrementalRenderMatchesFullRender);
+    RUN_TEST(failures, TestEmptyPalette);
+    return failures;
+}
@@ -0,0 +1,151 @@
+#include "test_utils.h"
+
+#include "json_reader.h"
+#include "map_renderer.h"
+#include "request_capture.h"
+#include "request_handler.h"
+#include "request_stats.h"
+#include "transport_catalogue.h"
+#include "transport_router.h"
+
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+using namespace std::literals;
+
+namespace {
+
+    std::vector<json_reader::StatRequest> MakeRequests() {
+        std::vector<json_reader::StatRequest> requests(3);
+        requests[0].id = 1;
+        requests[0].type = json_reader::RequestType::BUS;
+        requests[0].name = "14"s;
+        requests[1].id = -2;
+        requests[1].type = json_reader::RequestType::ROUTE;
+        requests[1].from = "A"s;
+        requests[1].to = "B"s;
+        requests[2].id = 3;
+        requests[2].type = json_reader::RequestType::MAP;
+        requests[2].area = renderer::Tile{ 1, 0, 1 };
+        return requests;
+    }
+
+    std::string Capture(const std::vector<json_reader::StatRequest>& requests) {
+        std::ostringstream output;
+        request_handler::RequestCapture capture(output);
+        for (const auto& request : requests) {
+            capture.Record(request);
+        }
+        return output.str();
+    }
+
+    std::vector<request_handler::CapturedRequest> Read(const std::string& capture) {
+        std::istringstream input(capture);
+        return request_handler::ReadCapture(input);
+    }
+
+    void TestRoundTrip() {
+        const auto requests = MakeRequests();
+        const auto captured = Read(Capture(requests));
+        ASSERT(captured.size() == requests.size());
+        for (size_t i = 0; i < requests.size(); ++i) {
+            ASSERT(captured[i].request.id == requests[i].id);
+            ASSERT(captured[i].request.type == requests[i].type);
+            ASSERT(captured[i].request.name == requests[i].name);
+            ASSERT(captured[i].request.from == requests[i].from);
+            ASSERT(captured[i].request.to == requests[i].to);
+            ASSERT(captured[i].request.area.index() == requests[i].area.index());
+        }
+    }
+
+    void TestCorruptedStringLength() {
+        // Запись запроса Bus: приращение времени, тип, id, затем длина названия
+        const std::string header = Capture({});
+        std::string record = "\x01"s;
+        record += static_cast<char>(json_reader::RequestType::BUS);
+        record += "\x02"s;
+        // Длина 2^63 в varint
+        record += "\x80\x80\x80\x80\x80\x80\x80\x80\x80\x01"s;
+        ASSERT(test_utils::Throws<std::runtime_error>([&] {
+            Read(header + record);
+            }));
+
+        // Длина в пределах разумного, но больше остатка файла
+        std::string short_record = "\x01"s;
+        short_record += static_cast<char>(json_reader::RequestType::BUS);
+        short_record += "\x02\x80\x80\x01"s;
+        short_record += "abc"s;
+        ASSERT(test_utils::Throws<std::runtime_error>([&] {
+            Read(header + short_record);
+            }));
+    }
+
+    void TestTruncatedCapture() {
+        const std::string capture = Capture(MakeRequests());
+        for (size_t size = 0; size < capture.size(); ++size) {
+            // Обрезка по границе записи даёт корректный файл с меньшим числом запросов
+            try {
+                Read(capture.substr(0, size));
+            }
+            catch (const std::runtime_error&) {
+            }
+        }
+    }
+
+    void TestReplayIsNotRecorded() {
+        const std::string document = R"({
+            "base_requests": [
+                {"type": "Stop", "name": "A", "latitude": 55.6, "longitude": 37.6, "road_distances": {"B": 1000}},
+                {"type": "Stop", "name": "B", "latitude": 55.7, "longitude": 37.7, "road_distances": {}},
+                {"type": "Bus", "name": "14", "stops": ["A", "B"], "is_roundtrip": false}
+            ],
+            "routing_settings": {"bus_wait_time": 6, "bus_velocity": 40},
+            "stat_requests": [{"id": 1, "type": "Bus", "name": "14"}]
+        })"s;
+        transport_catalogue::TransportCatalogue catalogue;
+        std::istringstream input(document);
+        json_reader::JsonReader reader(catalogue, input);
+        reader.LoadDataToCatalogue();
+        const renderer::MapRenderer renderer = reader.LoadRenderSettings();
+        const transport_catalogue::Router router(reader.LoadRoutingSettings(), catalogue);
+
+        std::ostringstream answers;
+        std::ostringstream capture_output;
+        request_handler::RequestCapture capture(capture_output);
+        request_handler::RequestStats stats;
+        request_handler::HandlerOptions options;
+        options.stats = &stats;
+        options.capture = &capture;
+        options.output = &answers;
+        const request_handler::RequestHandler handler(catalogue, renderer, reader, router, options);
+
+        const std::string captured_before = capture_output.str();
+        std::ostringstream stats_before;
+        stats.Print(stats_before);
+
+        auto requests = Read(Capture({ reader.GetStatRequests()[0], reader.GetStatRequests()[0] }));
+        request_handler::RequestStats replay_stats;
+        request_handler::ReplayCapture(handler, requests, 0.0, replay_stats);
+
+        std::ostringstream stats_after;
+        stats.Print(stats_after);
+        ASSERT(capture_output.str() == captured_before);
+        ASSERT(stats_after.str() == stats_before.str());
+
+        std::ostringstream replay_report;
+        replay_stats.Print(replay_report);
+        ASSERT(replay_report.str().find("Bus"s) != std::string::npos);
+    }
+
+}  // namespace
+
+int main() {
+    int failures = 0;
+    RUN_TEST(failures, TestRoundTrip);
+    RUN_TEST(failures, TestCorruptedStringLength);
+    RUN_TEST(failures, TestTruncatedCapture);
+    RUN_TEST(failures, TestReplayIsNotRecorded);
+    return failures;
+}
@@ -0,0 +1,101 @@
+#include "test_utils.h"
+
+#include "json_reader.h"
+#include "map_renderer.h"
+#include "request_handler.h"
+#include "transport_catalogue.h"
+#include "transport_router.h"
+
+#include <sstream>
+#include <string>
+
+using namespace std::literals;
+
+namespace {
+
+    // Справочник из трёх остановок и двух маршрутов, stat_requests дописываются в конец
+    const std::string BASE_DOCUMENT = R"({
+        "base_requests": [
+            {"type": "Stop", "name": "A", "latitude": 55.60, "longitude": 37.60, "road_distances": {"B": 1000}},
+            {"type": "Stop", "name": "B", "latitude": 55.61, "longitude": 37.62, "road_distances": {"C": 1500}},
+            {"type": "Stop", "name": "C", "latitude": 55.62, "longitude": 37.61, "road_distances": {"A": 1200}},
+            {"type": "Bus", "name": "1", "stops": ["A", "B", "C", "A"], "is_roundtrip": true},
+            {"type": "Bus", "name": "2", "stops": ["A", "C"], "is_roundtrip": false}
+        ],
+        "render_settings": {
+            "width": 600, "height": 400, "padding": 50, "line_width": 14, "stop_radius": 5,
+            "bus_label_font_size": 20, "bus_label_offset": [7, 15],
+            "stop_label_font_size": 18, "stop_label_offset": [7, -3],
+            "underlayer_color": [255, 255, 255, 0.85], "underlayer_width": 3,
+            "color_palette": ["green", [255, 160, 0], "red"]
+        },
+        "routing_settings": {"bus_wait_time": 6, "bus_velocity": 40},
+        "stat_requests": [)"s;
+
+    // Запросы всех типов, включая неизвестный и запросы к несуществующим объектам
+    std::string MakeStatRequests(int count) {
+        static const std::string templates[] = {
+            R"({"id": ID, "type": "Bus", "name": "1"})"s,
+            R"({"id": ID, "type": "Stop", "name": "B"})"s,
+            R"({"id": ID, "type": "Bus", "name": "404"})"s,
+            R"({"id": ID, "type": "Route", "from": "A", "to": "C"})"s,
+            R"({"id": ID, "type": "Stop", "name": "Z"})"s,
+            R"({"id": ID, "type": "Bogus", "name": "1"})"s,
+            R"({"id": ID, "type": "Map"})"s,
+        };
+        std::string result;
+        for (int id = 0; id < count; ++id) {
+            std::string request = templates[id % std::size(templates)];
+            request.replace(request.find("ID"), 2, std::to_string(id));
+            result += (id > 0 ? ","s : ""s) + request;
+        }
+        return result;
+    }
+
+    std::string Answer(const std::string& document, size_t thread_count) {
+        transport_catalogue::TransportCatalogue catalogue;
+        std::istringstream input(document);
+        json_reader::JsonReader reader(catalogue, input, json_reader::LoadMode::STREAMING);
+        reader.LoadDataToCatalogue();
+        const renderer::MapRenderer renderer = reader.LoadRenderSettings();
+        const transport_catalogue::Router router(reader.LoadRoutingSettings(), catalogue);
+
+        std::ostringstream output;
+        request_handler::HandlerOptions options;
+        options.thread_count = thread_count;
+        options.output = &output;
+        request_handler::RequestHandler handler(catalogue, renderer, reader, router, options);
+        return output.str();
+    }
+
+    void TestParallelAnswersMatchSequential() {
+        // Запросов больше, чем в одном блоке параллельной обработки
+        const std::string document = BASE_DOCUMENT + MakeStatRequests(200) + "]}"s;
+        const std::string sequential = Answer(document, 1);
+        for (const size_t thread_count : { 2, 3, 8 }) {
+            ASSERT_HINT(Answer(document, thread_count) == sequential, std::to_string(thread_count) + " threads"s);
+        }
+    }
+
+    void TestUnknownRequestIsSkipped() {
+        const std::string document = BASE_DOCUMENT + MakeStatRequests(200) + "]}"s;
+        const std::string answer = Answer(document, 2);
+        // Ответ остаётся корректным JSON-массивом без пустых элементов
+        const json::Document parsed = json::Load(answer);
+        // Каждый седьмой запрос, начиная с шестого, имеет неизвестный тип
+        size_t known_count = 0;
+        for (int id = 0; id < 200; ++id) {
+            known_count += id % 7 != 5;
+        }
+        ASSERT(parsed.GetRoot().AsArray().size() == known_count);
+        ASSERT(answer.find(",\n    ,"s) == std::string::npos);
+    }
+
+}  // namespace
+
+int main() {
+    int failures = 0;
+    RUN_TEST(failures, TestParallelAnswersMatchSequential);
+    RUN_TEST(failures, TestUnknownRequestIsSkipped);
+    return failures;
+}
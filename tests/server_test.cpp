@@ -0,0 +1,153 @@
+#include "test_utils.h"
+
+#include "json_reader.h"
+#include "map_renderer.h"
+#include "request_handler.h"
+#include "server.h"
+#include "transport_catalogue.h"
+#include "transport_router.h"
+
+#include <csignal>
+#include <cstring>
+#include <sstream>
+#include <string>
+#include <thread>
+
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+using namespace std::literals;
+
+namespace {
+
+    const std::string DOCUMENT = R"({
+        "base_requests": [
+            {"type": "Stop", "name": "A", "latitude": 55.6, "longitude": 37.6, "road_distances": {"B": 1000}},
+            {"type": "Stop", "name": "B", "latitude": 55.7, "longitude": 37.7, "road_distances": {}},
+            {"type": "Bus", "name": "14", "stops": ["A", "B"], "is_roundtrip": false}
+        ],
+        "routing_settings": {"bus_wait_time": 6, "bus_velocity": 40},
+        "stat_requests": []
+    })"s;
+
+    constexpr size_t MAX_DOCUMENT_SIZE = 1024;
+
+    json_reader::JsonReader& LoadCatalogue(json_reader::JsonReader& reader) {
+        reader.LoadDataToCatalogue();
+        return reader;
+    }
+
+    request_handler::HandlerOptions MakeOptions(std::ostream& output) {
+        request_handler::HandlerOptions options;
+        options.output = &output;
+        return options;
+    }
+
+    // Справочник и сервер, запущенный в отдельном потоке. Сервер останавливается
+    // сигналом SIGTERM, заблокированным во всех потоках теста
+    class TestServer {
+    public:
+        TestServer()
+            : input_(DOCUMENT)
+            , reader_(catalogue_, input_)
+            , renderer_(LoadCatalogue(reader_).LoadRenderSettings())
+            , router_(reader_.LoadRoutingSettings(), catalogue_)
+            , handler_(catalogue_, renderer_, reader_, router_, MakeOptions(answers_))
+            , socket_path_("/tmp/transport_catalogue_server_test_"s + std::to_string(getpid())) {
+            sigset_t signals;
+            sigemptyset(&signals);
+            sigaddset(&signals, SIGTERM);
+            sigprocmask(SIG_BLOCK, &signals, nullptr);
+            thread_ = std::jthread([this] {
+                server::Server(handler_, socket_path_, MAX_DOCUMENT_SIZE).Run();
+                });
+        }
+
+        ~TestServer() {
+            kill(getpid(), SIGTERM);
+        }
+
+        // Отправляет данные, закрывает соединение на запись и возвращает весь ответ сервера
+        std::string Exchange(std::string_view request) const {
+            const int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+            sockaddr_un address{};
+            address.sun_family = AF_UNIX;
+            std::memcpy(address.sun_path, socket_path_.c_str(), socket_path_.size() + 1);
+            // Сервер мог ещё не начать слушать сокет
+            while (connect(fd, reinterpret_cast<const sockaddr*>(&address), sizeof(address)) == -1) {
+                std::this_thread::yield();
+            }
+            for (size_t sent = 0; sent < request.size();) {
+                const ssize_t result = send(fd, request.data() + sent, request.size() - sent, MSG_NOSIGNAL);
+                if (result <= 0) {
+                    break;
+                }
+                sent += static_cast<size_t>(result);
+            }
+            shutdown(fd, SHUT_WR);
+            std::string response;
+            char block[4096];
+            ssize_t received = 0;
+            while ((received = recv(fd, block, sizeof(block), 0)) > 0) {
+                response.append(block, static_cast<size_t>(received));
+            }
+            close(fd);
+            return response;
+        }
+
+    private:
+        std::ostringstream answers_;
+        transport_catalogue::TransportCatalogue catalogue_;
+        std::istringstream input_;
+        json_reader::JsonReader reader_;
+        renderer::MapRenderer renderer_;
+        transport_catalogue::Router router_;
+        request_handler::RequestHandler handler_;
+        std::string socket_path_;
+        std::jthread thread_;
+    };
+
+    bool IsErrorResponse(const std::string& response) {
+        return response.find("\"error_message\""s) != std::string::npos;
+    }
+
+    void TestAnswers(const TestServer& server) {
+        const std::string response = server.Exchange(R"({"id": 1, "type": "Bus", "name": "14"} [{"id": 2, "type": "Stop", "name": "A"}])"sv);
+        // Ответы на документы следуют друг за другом в порядке получения
+        const size_t bus = response.find("\"route_length\""s);
+        const size_t stop = response.find("\"buses\""s);
+        ASSERT_HINT(bus != std::string::npos && stop != std::string::npos && bus < stop, response);
+        ASSERT_HINT(!IsErrorResponse(response), response);
+    }
+
+    void TestUnknownSingleRequest(const TestServer& server) {
+        const std::string response = server.Exchange(R"({"id": 7, "type": "Bogus"})"sv);
+        const json::Document document = json::Load(response);
+        ASSERT_HINT(document.GetRoot().AsMap().at("request_id"s).AsInt() == 7, response);
+        ASSERT_HINT(IsErrorResponse(response), response);
+    }
+
+    void TestStrayClosingBracket(const TestServer& server) {
+        // Без проверки глубина стала бы отрицательной, и следующий документ не был бы найден
+        const std::string response = server.Exchange(R"(] {"id": 1, "type": "Bus", "name": "14"})"sv);
+        ASSERT_HINT(IsErrorResponse(response), response);
+        ASSERT_HINT(response.find("\"request_id\""s) == std::string::npos, response);
+    }
+
+    void TestDocumentTooLong(const TestServer& server) {
+        const std::string response = server.Exchange("[\""s + std::string(MAX_DOCUMENT_SIZE * 4, 'x'));
+        ASSERT_HINT(IsErrorResponse(response), response);
+    }
+
+}  // namespace
+
+int main() {
+    const TestServer server;
+    int failures = 0;
+    failures += test_utils::RunTest("TestAnswers"sv, [&] { TestAnswers(server); });
+    failures += test_utils::RunTest("TestUnknownSingleRequest"sv, [&] { TestUnknownSingleRequest(server); });
+    failures += test_utils::RunTest("TestStrayClosingBracket"sv, [&] { TestStrayClosingBracket(server); });
+    failures += test_utils::RunTest("TestDocumentTooLong"sv, [&] { TestDocumentTooLong(server); });
+    return failures;
+}
@@ -0,0 +1,71 @@
+#pragma once
+
+#include <exception>
+#include <iostream>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+
+/*
+ * Минимальная поддержка тестов без сторонних библиотек.
+ * Каждый тестовый файл собирается в отдельную программу, которая запускает свои тесты
+ * через RunTest и возвращает из main число упавших тестов
+ */
+
+namespace test_utils {
+
+    class AssertionError : public std::runtime_error {
+    public:
+        using std::runtime_error::runtime_error;
+    };
+
+    inline void Assert(bool condition, std::string_view expression, std::string_view file, int line,
+        std::string_view message = {}) {
+        using namespace std::literals;
+        if (condition) {
+            return;
+        }
+        std::ostringstream error;
+        error << file << ':' << line << ": ASSERT("sv << expression << ") failed"sv;
+        if (!message.empty()) {
+            error << ": "sv << message;
+        }
+        throw AssertionError(error.str());
+    }
+
+    // Возвращает 1, если тест упал, иначе 0
+    template <typename Test>
+    int RunTest(std::string_view name, Test&& test) {
+        using namespace std::literals;
+        try {
+            test();
+            std::cerr << name << " OK\n"sv;
+            return 0;
+        }
+        catch (const std::exception& e) {
+            std::cerr << name << " FAILED: "sv << e.what() << '\n';
+            return 1;
+        }
+    }
+
+    // Проверяет, что action выбрасывает исключение типа Exception
+    template <typename Exception, typename Action>
+    bool Throws(Action&& action) {
+        try {
+            action();
+        }
+        catch (const Exception&) {
+            return true;
+        }
+        catch (...) {
+            return false;
+        }
+        return false;
+    }
+
+}  // namespace test_utils
+
+#define ASSERT(expression) ::test_utils::Assert(static_cast<bool>(expression), #expression, __FILE__, __LINE__)
+#define ASSERT_HINT(expression, hint) ::test_utils::Assert(static_cast<bool>(expression), #expression, __FILE__, __LINE__, (hint))
+#define RUN_TEST(failures, test) (failures) += ::test_utils::RunTest(#test, (test))
@@ -0,0 +1,193 @@
+#include "binary_protocol.h"
+
+#include <algorithm>
+#include <bit>
+#include <cstdint>
+#include <stdexcept>
+
+namespace binary_protocol {
+
+    namespace {
+        using namespace std::literals;
+
+        constexpr size_t HEADER_SIZE = sizeof(uint32_t);
+
+        void AppendUInt32(std::string& output, uint32_t value) {
+            for (int byte = 0; byte < 4; ++byte) {
+                output.push_back(static_cast<char>((value >> (8 * byte)) & 0xFF));
+            }
+        }
+
+        void AppendUInt64(std::string& output, uint64_t value) {
+            for (int byte = 0; byte < 8; ++byte) {
+                output.push_back(static_cast<char>((value >> (8 * byte)) & 0xFF));
+            }
+        }
+
+        void StoreUInt32(std::string& output, size_t position, uint32_t value) {
+            for (int byte = 0; byte < 4; ++byte) {
+                output[position + byte] = static_cast<char>((value >> (8 * byte)) & 0xFF);
+            }
+        }
+
+        uint32_t LoadUInt32(const char* data) {
+            uint32_t value = 0;
+            for (int byte = 0; byte < 4; ++byte) {
+                value |= static_cast<uint32_t>(static_cast<unsigned char>(data[byte])) << (8 * byte);
+            }
+            return value;
+        }
+
+        // Последовательное чтение полей содержимого кадра с проверкой длины
+        class PayloadReader {
+        public:
+            explicit PayloadReader(std::string_view payload)
+                : payload_(payload) {
+            }
+
+            bool UInt8(uint8_t& value) {
+                if (payload_.empty()) {
+                    return false;
+                }
+                value = static_cast<uint8_t>(payload_.front());
+                payload_.remove_prefix(1);
+                return true;
+            }
+
+            bool UInt32(uint32_t& value) {
+                if (payload_.size() < 4) {
+                    return false;
+                }
+                value = LoadUInt32(payload_.data());
+                payload_.remove_prefix(4);
+                return true;
+            }
+
+            bool Double(double& value) {
+                if (payload_.size() < 8) {
+                    return false;
+                }
+                const uint64_t bits = LoadUInt32(payload_.data()) | static_cast<uint64_t>(LoadUInt32(payload_.data() + 4)) << 32;
+                value = std::bit_cast<double>(bits);
+                payload_.remove_prefix(8);
+                return true;
+            }
+
+            bool AtEnd() const {
+                return payload_.empty();
+            }
+
+        private:
+            std::string_view payload_;
+        };
+
+        bool DecodeMapArea(PayloadReader& reader, renderer::MapArea& area) {
+            uint8_t type = 0;
+            if (!reader.UInt8(type)) {
+                return false;
+            }
+            switch (static_cast<MapAreaType>(type)) {
+            case MapAreaType::RECT: {
+                renderer::GeoRect rect;
+                if (!reader.Double(rect.min_lat) || !reader.Double(rect.min_lng)
+                    || !reader.Double(rect.max_lat) || !reader.Double(rect.max_lng)) {
+                    return false;
+                }
+                area = rect;
+                return true;
+            }
+            case MapAreaType::TILE: {
+                uint32_t z = 0;
+                uint32_t x = 0;
+                uint32_t y = 0;
+                if (!reader.UInt32(z) || !reader.UInt32(x) || !reader.UInt32(y)) {
+                    return false;
+                }
+                // Слишком большие значения дадут несуществующий тайл
+                area = renderer::Tile{ static_cast<int>(std::min<uint32_t>(z, INT32_MAX)),
+                    static_cast<int>(std::min<uint32_t>(x, INT32_MAX)), static_cast<int>(std::min<uint32_t>(y, INT32_MAX)) };
+                return true;
+            }
+            default:
+                return false;
+            }
+        }
+    }  // namespace
+
+    size_t FindFrameEnd(std::string_view input, uint32_t max_payload_size) {
+        if (input.size() < HEADER_SIZE) {
+            return 0;
+        }
+        const uint32_t payload_size = LoadUInt32(input.data());
+        if (payload_size > max_payload_size) {
+            throw std::length_error("Frame is too long"s);
+        }
+        const size_t size = HEADER_SIZE + payload_size;
+        return input.size() < size ? 0 : size;
+    }
+
+    bool DecodeRequest(std::string_view payload, Request& request) {
+        PayloadReader reader(payload);
+        uint32_t id = 0;
+        uint8_t type = 0;
+        if (!reader.UInt32(id)) {
+            return false;
+        }
+        request.id = static_cast<int32_t>(id);
+        if (!reader.UInt8(type)) {
+            return false;
+        }
+        request.type = static_cast<json_reader::RequestType>(type);
+
+        bool valid = false;
+        switch (request.type) {
+        case json_reader::RequestType::STOP:
+        case json_reader::RequestType::BUS:
+            valid = reader.UInt32(request.object);
+            break;
+        case json_reader::RequestType::ROUTE:
+            valid = reader.UInt32(request.object) && reader.UInt32(request.to);
+            break;
+        case json_reader::RequestType::MAP:
+            valid = reader.AtEnd() || DecodeMapArea(reader, request.area);
+            break;
+        default:
+            break;
+        }
+        return valid && reader.AtEnd();
+    }
+
+    ResponseWriter::ResponseWriter(std::string& output, int id, Status status)
+        : output_(output)
+        , frame_start_(output.size()) {
+        AppendUInt32(output_, 0);
+        AppendUInt32(output_, static_cast<uint32_t>(id));
+        output_.push_back(static_cast<char>(status));
+    }
+
+    ResponseWriter& ResponseWriter::UInt8(uint8_t value) {
+        output_.push_back(static_cast<char>(value));
+        return *this;
+    }
+
+    ResponseWriter& ResponseWriter::UInt32(uint32_t value) {
+        AppendUInt32(output_, value);
+        return *this;
+    }
+
+    ResponseWriter& ResponseWriter::Double(double value) {
+        AppendUInt64(output_, std::bit_cast<uint64_t>(value));
+        return *this;
+    }
+
+    ResponseWriter& ResponseWriter::Bytes(std::string_view value) {
+        AppendUInt32(output_, static_cast<uint32_t>(value.size()));
+        output_.append(value);
+        return *this;
+    }
+
+    void ResponseWriter::End() {
+        StoreUInt32(output_, frame_start_, static_cast<uint32_t>(output_.size() - frame_start_ - HEADER_SIZE));
+    }
+
+}  // namespace binary_protocol
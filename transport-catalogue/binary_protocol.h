@@ -0,0 +1,91 @@
+#pragma once
+
+#include "json_reader.h"
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+namespace binary_protocol {
+
+    // Двоичный протокол запросов stat_requests для обмена между программами.
+    // Каждое сообщение - кадр: длина содержимого (uint32), затем содержимое.
+    // Все числа little-endian, вещественные - IEEE 754 double.
+    // Остановки и маршруты передаются номерами из справочника (Stop::id, Bus::id),
+    // то есть порядковыми номерами в base_requests среди остановок и среди маршрутов.
+    //
+    // Запрос: id (int32), тип (uint8, значение json_reader::RequestType), затем
+    //   Stop  - номер остановки (uint32)
+    //   Bus   - номер маршрута (uint32)
+    //   Route - номера остановок from и to (uint32, uint32)
+    //   Map   - ничего для всей карты, либо 1 (uint8) и min_lat, min_lng, max_lat, max_lng
+    //           (double) для прямоугольника, либо 2 (uint8) и z, x, y (uint32) для тайла
+    //
+    // Ответ: id (int32), Status (uint8), затем при Status::OK
+    //   Stop  - число маршрутов (uint32) и их номера (uint32) в порядке названий
+    //   Bus   - curvature (double), route_length (double), stop_count (uint32),
+    //           unique_stop_count (uint32)
+    //   Route - total_time (double), число элементов (uint32), затем элементы:
+    //           Wait - 0 (uint8), номер остановки (uint32), time (double)
+    //           Bus  - 1 (uint8), номер маршрута (uint32), span_count (uint32), time (double)
+    //   Map   - длина (uint32) и текст SVG
+
+    // Кадр длиннее этого считается ошибкой: запросы занимают не больше десятка байт
+    constexpr uint32_t MAX_REQUEST_SIZE = 1024;
+
+    enum class Status : uint8_t {
+        OK,
+        NOT_FOUND,
+        BAD_REQUEST,
+    };
+
+    enum class MapAreaType : uint8_t {
+        FULL,
+        RECT,
+        TILE,
+    };
+
+    enum class RouteItemType : uint8_t {
+        WAIT,
+        BUS,
+    };
+
+    struct Request {
+        int id = 0;
+        json_reader::RequestType type = json_reader::RequestType::UNKNOWN;
+        // Номер остановки (Stop, начало Route) или маршрута (Bus)
+        uint32_t object = 0;
+        // Номер конечной остановки Route
+        uint32_t to = 0;
+        // Часть карты для Map
+        renderer::MapArea area;
+    };
+
+    // Возвращает длину первого полного кадра в input вместе с заголовком или 0,
+    // если кадр ещё не получен целиком. Если заявленная длина содержимого больше
+    // max_payload_size, выбрасывает std::length_error
+    size_t FindFrameEnd(std::string_view input, uint32_t max_payload_size);
+
+    // Разбирает содержимое кадра запроса. Возвращает false, если содержимое не соответствует
+    // формату; id в этом случае заполняется, если его удалось прочитать
+    bool DecodeRequest(std::string_view payload, Request& request);
+
+    // Дописывает кадр ответа в output. Длина кадра записывается в End
+    class ResponseWriter {
+    public:
+        ResponseWriter(std::string& output, int id, Status status);
+
+        ResponseWriter& UInt8(uint8_t value);
+        ResponseWriter& UInt32(uint32_t value);
+        ResponseWriter& Double(double value);
+        // Длина (uint32) и байты
+        ResponseWriter& Bytes(std::string_view value);
+
+        void End();
+
+    private:
+        std::string& output_;
+        size_t frame_start_;
+    };
+
+}  // namespace binary_protocol
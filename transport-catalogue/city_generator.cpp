@@ -0,0 +1,276 @@
+#include "city_generator.h"
+
+#include "geo.h"
+#include "json.h"
+
+#include <algorithm>
+#include <charconv>
+#include <cmath>
+#include <map>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace city_generator {
+
+    namespace {
+        using namespace std::literals;
+
+        // Распределения стандартной библиотеки зависят от её реализации, поэтому
+        // случайные величины строятся прямо из std::mt19937, выход которого фиксирован стандартом
+        class Random {
+        public:
+            explicit Random(uint32_t seed)
+                : engine_(seed) {
+            }
+
+            // Целое из [from, to]
+            int Uniform(int from, int to) {
+                return from + static_cast<int>(engine_() % static_cast<uint32_t>(to - from + 1));
+            }
+
+            double Real(double from, double to) {
+                return from + (to - from) * (static_cast<double>(engine_()) / 4294967296.0);
+            }
+
+            bool Chance(double probability) {
+                return Real(0.0, 1.0) < probability;
+            }
+
+        private:
+            std::mt19937 engine_;
+        };
+
+        template <typename Value>
+        Value ParseNumber(std::string_view key, std::string_view text) {
+            Value value{};
+            const auto [ptr, ec] = std::from_chars(text.data(), text.data() + text.size(), value);
+            if (ec != std::errc{} || ptr != text.data() + text.size()) {
+                throw std::invalid_argument("Invalid value of "s + std::string(key) + ": "s + std::string(text));
+            }
+            return value;
+        }
+
+        std::string StopName(int stop) {
+            return "Stop "s + std::to_string(stop);
+        }
+
+        std::string BusName(int bus) {
+            return "Bus "s + std::to_string(bus);
+        }
+
+        struct Route {
+            std::vector<int> stops;
+            bool is_roundtrip = false;
+        };
+
+        void WriteRenderSettings(json::Writer& writer) {
+            writer.Key("render_settings").StartDict()
+                .Key("bus_label_font_size").Value(20)
+                .Key("bus_label_offset").StartArray().Value(7.0).Value(15.0).EndArray()
+                .Key("color_palette").StartArray()
+                    .Value("green")
+                    .StartArray().Value(255).Value(160).Value(0).EndArray()
+                    .Value("red")
+                    .EndArray()
+                .Key("height").Value(1200.0)
+                .Key("line_width").Value(14.0)
+                .Key("padding").Value(50.0)
+                .Key("stop_label_font_size").Value(18)
+                .Key("stop_label_offset").StartArray().Value(7.0).Value(-3.0).EndArray()
+                .Key("stop_radius").Value(5.0)
+                .Key("underlayer_color").StartArray().Value(255).Value(255).Value(255).Value(0.85).EndArray()
+                .Key("underlayer_width").Value(3.0)
+                .Key("width").Value(1200.0)
+                .EndDict();
+        }
+    }  // namespace
+
+    CityParams ParseCityParams(std::string_view spec) {
+        CityParams params;
+        while (!spec.empty()) {
+            const size_t comma = spec.find(',');
+            const std::string_view item = spec.substr(0, comma);
+            spec.remove_prefix(comma == std::string_view::npos ? spec.size() : comma + 1);
+
+            const size_t equals = item.find('=');
+            if (equals == std::string_view::npos) {
+                throw std::invalid_argument("key=value is expected: "s + std::string(item));
+            }
+            const std::string_view key = item.substr(0, equals);
+            const std::string_view value = item.substr(equals + 1);
+            if (key == "seed"sv) {
+                params.seed = ParseNumber<uint32_t>(key, value);
+            }
+            else if (key == "stops"sv) {
+                params.stop_count = ParseNumber<int>(key, value);
+            }
+            else if (key == "buses"sv) {
+                params.bus_count = ParseNumber<int>(key, value);
+            }
+            else if (key == "min_route"sv) {
+                params.min_route_length = ParseNumber<int>(key, value);
+            }
+            else if (key == "max_route"sv) {
+                params.max_route_length = ParseNumber<int>(key, value);
+            }
+            else if (key == "roundtrip"sv) {
+                params.roundtrip_ratio = ParseNumber<double>(key, value);
+            }
+            else if (key == "density"sv) {
+                params.distance_density = ParseNumber<double>(key, value);
+            }
+            else if (key == "bus_requests"sv) {
+                params.bus_requests = ParseNumber<int>(key, value);
+            }
+            else if (key == "stop_requests"sv) {
+                params.stop_requests = ParseNumber<int>(key, value);
+            }
+            else if (key == "route_requests"sv) {
+                params.route_requests = ParseNumber<int>(key, value);
+            }
+            else if (key == "map_requests"sv) {
+                params.map_requests = ParseNumber<int>(key, value);
+            }
+            else {
+                throw std::invalid_argument("Unknown city parameter: "s + std::string(key));
+            }
+        }
+
+        if (params.stop_count < 2 || params.bus_count < 0 || params.min_route_length < 2
+            || params.max_route_length < params.min_route_length) {
+            throw std::invalid_argument("Invalid city size"s);
+        }
+        return params;
+    }
+
+    void GenerateCity(const CityParams& params, std::ostream& output) {
+        Random random(params.seed);
+
+        std::vector<geo::Coordinates> coordinates;
+        coordinates.reserve(params.stop_count);
+        for (int stop = 0; stop < params.stop_count; ++stop) {
+            coordinates.push_back({ random.Real(55.55, 55.95), random.Real(37.3, 37.9) });
+        }
+
+        // Расстояние по дорогам длиннее расстояния по прямой
+        std::map<std::pair<int, int>, int> distances;
+        auto add_distance = [&distances, &coordinates, &random](int from, int to) {
+            if (from == to || distances.count({ from, to }) || distances.count({ to, from })) {
+                return;
+            }
+            const double direct = geo::ComputeDistance(coordinates[from], coordinates[to]);
+            distances[{ from, to }] = std::max(1, static_cast<int>(std::lround(direct * random.Real(1.1, 1.6))));
+        };
+
+        std::vector<Route> routes(params.bus_count);
+        for (Route& route : routes) {
+            const int length = std::min(random.Uniform(params.min_route_length, params.max_route_length), params.stop_count);
+            route.is_roundtrip = random.Chance(params.roundtrip_ratio);
+            route.stops.push_back(random.Uniform(0, params.stop_count - 1));
+            while (static_cast<int>(route.stops.size()) < length) {
+                const int next = random.Uniform(0, params.stop_count - 1);
+                if (next != route.stops.back()) {
+                    add_distance(route.stops.back(), next);
+                    route.stops.push_back(next);
+                }
+            }
+            if (route.is_roundtrip) {
+                add_distance(route.stops.back(), route.stops.front());
+                route.stops.push_back(route.stops.front());
+            }
+        }
+
+        for (int stop = 0; stop < params.stop_count; ++stop) {
+            const double extra = params.distance_density;
+            const int count = static_cast<int>(extra) + (random.Chance(extra - std::floor(extra)) ? 1 : 0);
+            for (int i = 0; i < count; ++i) {
+                add_distance(stop, random.Uniform(0, params.stop_count - 1));
+            }
+        }
+
+        // Координатам нужно больше знаков, чем 6 по умолчанию
+        const auto precision = output.precision(9);
+        json::Writer writer(output);
+        writer.StartDict();
+
+        writer.Key("base_requests").StartArray();
+        auto distance = distances.begin();
+        for (int stop = 0; stop < params.stop_count; ++stop) {
+            writer.StartDict()
+                .Key("type").Value("Stop")
+                .Key("name").Value(StopName(stop))
+                .Key("latitude").Value(coordinates[stop].lat)
+                .Key("longitude").Value(coordinates[stop].lng)
+                .Key("road_distances").StartDict();
+            for (; distance != distances.end() && distance->first.first == stop; ++distance) {
+                writer.Key(StopName(distance->first.second)).Value(distance->second);
+            }
+            writer.EndDict().EndDict();
+        }
+        for (int bus = 0; bus < params.bus_count; ++bus) {
+            writer.StartDict()
+                .Key("type").Value("Bus")
+                .Key("name").Value(BusName(bus))
+                .Key("stops").StartArray();
+            for (const int stop : routes[bus].stops) {
+                writer.Value(StopName(stop));
+            }
+            writer.EndArray()
+                .Key("is_roundtrip").Value(routes[bus].is_roundtrip)
+                .EndDict();
+        }
+        writer.EndArray();
+
+        WriteRenderSettings(writer);
+        writer.Key("routing_settings").StartDict()
+            .Key("bus_velocity").Value(40)
+            .Key("bus_wait_time").Value(6)
+            .EndDict();
+
+        // Запросы разных типов перемешиваются. Небольшая доля запросов
+        // обращается к несуществующим остановкам и маршрутам
+        enum class RequestKind { BUS, STOP, ROUTE, MAP };
+        std::vector<RequestKind> kinds;
+        kinds.insert(kinds.end(), std::max(0, params.bus_requests), RequestKind::BUS);
+        kinds.insert(kinds.end(), std::max(0, params.stop_requests), RequestKind::STOP);
+        kinds.insert(kinds.end(), std::max(0, params.route_requests), RequestKind::ROUTE);
+        kinds.insert(kinds.end(), std::max(0, params.map_requests), RequestKind::MAP);
+        for (int i = static_cast<int>(kinds.size()) - 1; i > 0; --i) {
+            std::swap(kinds[i], kinds[random.Uniform(0, i)]);
+        }
+
+        writer.Key("stat_requests").StartArray();
+        int id = 0;
+        for (const RequestKind kind : kinds) {
+            writer.StartDict().Key("id").Value(++id);
+            switch (kind) {
+            case RequestKind::BUS:
+                writer.Key("type").Value("Bus")
+                    .Key("name").Value(random.Chance(0.05) ? "Unknown bus"s : BusName(random.Uniform(0, std::max(0, params.bus_count - 1))));
+                break;
+            case RequestKind::STOP:
+                writer.Key("type").Value("Stop")
+                    .Key("name").Value(random.Chance(0.05) ? "Unknown stop"s : StopName(random.Uniform(0, params.stop_count - 1)));
+                break;
+            case RequestKind::ROUTE:
+                writer.Key("type").Value("Route")
+                    .Key("from").Value(StopName(random.Uniform(0, params.stop_count - 1)))
+                    .Key("to").Value(StopName(random.Uniform(0, params.stop_count - 1)));
+                break;
+            case RequestKind::MAP:
+                writer.Key("type").Value("Map");
+                break;
+            }
+            writer.EndDict();
+        }
+        writer.EndArray();
+
+        writer.EndDict();
+        output << std::endl;
+        output.precision(precision);
+    }
+
+}  // namespace city_generator
@@ -0,0 +1,40 @@
+#pragma once
+
+#include <cstdint>
+#include <iostream>
+#include <string_view>
+
+namespace city_generator {
+
+    // Параметры синтетического города. Один и тот же набор параметров
+    // всегда даёт один и тот же документ
+    struct CityParams {
+        uint32_t seed = 1;
+        int stop_count = 100;
+        int bus_count = 20;
+        // Число остановок в описании маршрута
+        int min_route_length = 5;
+        int max_route_length = 20;
+        // Доля кольцевых маршрутов
+        double roundtrip_ratio = 0.5;
+        // Среднее число дополнительных road_distances на остановку, сверх нужных маршрутам
+        double distance_density = 1.0;
+
+        // Состав stat_requests
+        int bus_requests = 100;
+        int stop_requests = 100;
+        int route_requests = 100;
+        int map_requests = 1;
+    };
+
+    // Разбирает параметры вида "stops=1000,buses=100,roundtrip=0.3".
+    // Ключи: seed, stops, buses, min_route, max_route, roundtrip, density,
+    // bus_requests, stop_requests, route_requests, map_requests.
+    // Неизвестный ключ или неверное значение приводят к std::invalid_argument
+    CityParams ParseCityParams(std::string_view spec);
+
+    // Записывает входной документ справочника: base_requests, render_settings,
+    // routing_settings и stat_requests
+    void GenerateCity(const CityParams& params, std::ostream& output);
+
+}  // namespace city_generator
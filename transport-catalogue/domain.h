@@ -23,12 +23,16 @@ namespace transport_catalogue
     struct Stop {
         std::string name;
         geo::Coordinates coods;
+        // Порядковый номер остановки в справочнике
+        size_t id = 0;
     };
 
     struct Bus {
         std::string name;
         std::vector<const Stop*> stops;
         bool is_circle;
+        // Порядковый номер маршрута в справочнике
+        size_t id = 0;
     };
 
     struct BusInfo {
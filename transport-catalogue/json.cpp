@@ -1,49 +1,251 @@
 #include "json.h"
+#include "number_format.h"
+#include "tracing.h"
 
+#include <algorithm>
+#include <array>
+#include <cctype>
+#include <charconv>
+#include <future>
 #include <iterator>
+#include <optional>
+#include <span>
+#include <thread>
+#include <unordered_set>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+#define JSON_USE_SSE2
+#endif
 
 namespace json {
 
     namespace {
         using namespace std::literals;
 
-        Node LoadNode(std::istream& input);
-        Node LoadString(std::istream& input);
+        // Символы, на которых останавливается сканирование строкового литерала
+        bool IsStringSpecial(char c) {
+            return c == '"' || c == '\\' || c == '\n' || c == '\r';
+        }
+
+        bool IsSpace(char c) {
+            return std::isspace(static_cast<unsigned char>(c));
+        }
+
+#ifdef JSON_USE_SSE2
+        constexpr size_t SIMD_BLOCK_SIZE = sizeof(__m128i);
+
+        // Маска байтов блока, равных c
+        __m128i EqualMask(__m128i block, char c) {
+            return _mm_cmpeq_epi8(block, _mm_set1_epi8(c));
+        }
+
+        int FirstSetBit(int mask) {
+#ifdef _MSC_VER
+            unsigned long index;
+            _BitScanForward(&index, static_cast<unsigned long>(mask));
+            return static_cast<int>(index);
+#else
+            return __builtin_ctz(static_cast<unsigned>(mask));
+#endif
+        }
+#endif
 
-        std::string LoadLiteral(std::istream& input) {
-            std::string s;
-            while (std::isalpha(input.peek())) {
-                s.push_back(static_cast<char>(input.get()));
+        // Возвращает указатель на первый символ из IsStringSpecial в [pos, end) или end.
+        // С SSE2 проверяется по 16 байт за раз, хвост досматривается побайтно
+        const char* FindStringSpecial(const char* pos, const char* end) {
+#ifdef JSON_USE_SSE2
+            for (; end - pos >= static_cast<ptrdiff_t>(SIMD_BLOCK_SIZE); pos += SIMD_BLOCK_SIZE) {
+                const __m128i block = _mm_loadu_si128(reinterpret_cast<const __m128i*>(pos));
+                const __m128i special = _mm_or_si128(
+                    _mm_or_si128(EqualMask(block, '"'), EqualMask(block, '\\')),
+                    _mm_or_si128(EqualMask(block, '\n'), EqualMask(block, '\r')));
+                if (const int mask = _mm_movemask_epi8(special)) {
+                    return pos + FirstSetBit(mask);
+                }
             }
-            return s;
+#endif
+            return std::find_if(pos, end, IsStringSpecial);
+        }
+
+        // Возвращает указатель на первый непробельный символ в [pos, end) или end.
+        // Пробельные символы те же, что у std::isspace в локали "C"
+        const char* SkipSpaces(const char* pos, const char* end) {
+#ifdef JSON_USE_SSE2
+            for (; end - pos >= static_cast<ptrdiff_t>(SIMD_BLOCK_SIZE); pos += SIMD_BLOCK_SIZE) {
+                const __m128i block = _mm_loadu_si128(reinterpret_cast<const __m128i*>(pos));
+                // Символы '\t', '\n', '\v', '\f', '\r' идут подряд с кодами 9..13
+                const __m128i control = _mm_and_si128(
+                    _mm_cmpgt_epi8(block, _mm_set1_epi8('\t' - 1)),
+                    _mm_cmplt_epi8(block, _mm_set1_epi8('\r' + 1)));
+                const __m128i spaces = _mm_or_si128(EqualMask(block, ' '), control);
+                if (const int mask = ~_mm_movemask_epi8(spaces) & 0xFFFF) {
+                    return pos + FirstSetBit(mask);
+                }
+            }
+#endif
+            return std::find_if_not(pos, end, IsSpace);
         }
 
-        Node LoadArray(std::istream& input) {
-            std::vector<Node> result;
+    }  // namespace
+
+    namespace detail {
+
+        // Непрерывный буфер с входными данными, по которому парсер двигается указателем.
+        // Буфер не владеет данными: они должны жить, пока идёт разбор.
+        // Узлы документа размещаются в ресурсе памяти Resource()
+        class Buffer {
+        public:
+            Buffer(std::string_view input, std::pmr::memory_resource* resource)
+                : pos_(input.data())
+                , end_(input.data() + input.size())
+                , resource_(resource) {
+            }
+
+            std::pmr::memory_resource* Resource() const {
+                return resource_;
+            }
+
+            // Переключает ресурс памяти для следующих узлов, возвращает прежний
+            std::pmr::memory_resource* SetResource(std::pmr::memory_resource* resource) {
+                return std::exchange(resource_, resource);
+            }
+
+            // Общие для всех уровней вложенности стеки, куда складываются элементы
+            // разбираемых массивов и словарей. Контейнер в арене создаётся один раз
+            // под точное число элементов и не оставляет в ней брошенных буферов от роста
+            std::vector<Node>& ArrayItems() {
+                return array_items_;
+            }
+            std::vector<Dict::value_type>& DictItems() {
+                return dict_items_;
+            }
+
+            bool Empty() const {
+                return pos_ == end_;
+            }
+
+            // Возвращает очередной символ, не извлекая его, или EOF в конце буфера
+            int Peek() const {
+                return Empty() ? std::char_traits<char>::eof() : static_cast<unsigned char>(*pos_);
+            }
+
+            char Get() {
+                return *pos_++;
+            }
+
+            void Unget() {
+                --pos_;
+            }
+
+            const char* Pos() const {
+                return pos_;
+            }
+
+            const char* End() const {
+                return end_;
+            }
+
+            // Переходит к позиции pos внутри буфера
+            void MoveTo(const char* pos) {
+                pos_ = pos;
+            }
+
+            // Аналог input >> c: пропускает пробельные символы и считывает следующий.
+            // Возвращает false, если буфер закончился
+            bool ReadNonSpace(char& c) {
+                pos_ = SkipSpaces(pos_, end_);
+                if (pos_ == end_) {
+                    return false;
+                }
+                c = *pos_++;
+                return true;
+            }
+
+        private:
+            const char* pos_;
+            const char* end_;
+            std::pmr::memory_resource* resource_;
+            std::vector<Node> array_items_;
+            std::vector<Dict::value_type> dict_items_;
+        };
+
+    }  // namespace detail
+
+    namespace {
+
+        using detail::Buffer;
+
+        Node LoadNode(Buffer& input);
+        String LoadString(Buffer& input);
 
-            for (char c; input >> c && c != ']';) {
+        std::string_view LoadLiteral(Buffer& input) {
+            const char* begin = input.Pos();
+            while (std::isalpha(input.Peek())) {
+                input.Get();
+            }
+            return { begin, static_cast<size_t>(input.Pos() - begin) };
+        }
+
+        // Разбирает элементы массива после открывающей скобки,
+        // для каждого элемента вызывая load_item(input)
+        template <typename ItemLoader>
+        void LoadArrayItems(Buffer& input, ItemLoader&& load_item) {
+            char c = 0;
+            bool closed = false;
+            while (input.ReadNonSpace(c)) {
+                if (c == ']') {
+                    closed = true;
+                    break;
+                }
                 if (c != ',') {
-                    input.putback(c);
+                    input.Unget();
                 }
-                result.push_back(LoadNode(input));
+                load_item(input);
             }
-            if (!input) {
+            if (!closed) {
                 throw ParsingError("Array parsing error"s);
             }
+        }
+
+        Node LoadArray(Buffer& input) {
+            auto& items = input.ArrayItems();
+            const size_t first_item = items.size();
+            LoadArrayItems(input, [&items](Buffer& input) {
+                items.push_back(LoadNode(input));
+                });
+
+            Array result(input.Resource());
+            result.reserve(items.size() - first_item);
+            std::move(items.begin() + first_item, items.end(), std::back_inserter(result));
+            items.erase(items.begin() + first_item, items.end());
             return Node(std::move(result));
         }
 
-        Node LoadDict(std::istream& input) {
-            Dict dict;
+        // Разбирает словарь после открывающей скобки. Значение каждого ключа разбирает
+        // load_value(key, input). Если он вернул std::nullopt, значение уже обработано
+        // им самим и в словарь не попадает
+        template <typename ValueLoader>
+        Node LoadDictWith(Buffer& input, ValueLoader&& load_value) {
+            auto& items = input.DictItems();
+            const size_t first_item = items.size();
 
-            for (char c; input >> c && c != '}';) {
+            char c = 0;
+            bool closed = false;
+            while (input.ReadNonSpace(c)) {
+                if (c == '}') {
+                    closed = true;
+                    break;
+                }
                 if (c == '"') {
-                    std::string key = LoadString(input).AsString();
-                    if (input >> c && c == ':') {
-                        if (dict.find(key) != dict.end()) {
-                            throw ParsingError("Duplicate key '"s + key + "' have been found");
+                    String key = LoadString(input);
+                    if (input.ReadNonSpace(c) && c == ':') {
+                        if (std::optional<Node> value = load_value(key, input)) {
+                            items.emplace_back(std::move(key), std::move(*value));
                         }
-                        dict.emplace(std::move(key), LoadNode(input));
                     }
                     else {
                         throw ParsingError(": is expected but '"s + c + "' has been found"s);
@@ -53,31 +255,167 @@ namespace json {
                     throw ParsingError(R"(',' is expected but ')"s + c + "' has been found"s);
                 }
             }
-            if (!input) {
+            if (!closed) {
                 throw ParsingError("Dictionary parsing error"s);
             }
+
+            Dict dict(input.Resource());
+            dict.reserve(items.size() - first_item);
+            for (auto it = items.begin() + first_item; it != items.end(); ++it) {
+                if (const auto [existing, inserted] = dict.emplace(std::move(it->first), std::move(it->second)); !inserted) {
+                    throw ParsingError("Duplicate key '"s + std::string(existing->first) + "' have been found");
+                }
+            }
+            items.erase(items.begin() + first_item, items.end());
             return Node(std::move(dict));
         }
 
-        Node LoadString(std::istream& input) {
-            auto it = std::istreambuf_iterator<char>(input);
-            auto end = std::istreambuf_iterator<char>();
-            std::string s;
+        Node LoadDict(Buffer& input) {
+            return LoadDictWith(input, [](const String&, Buffer& input) -> std::optional<Node> {
+                return LoadNode(input);
+                });
+        }
+
+        // Значения под ключами из handlers не попадают в словарь,
+        // их читает соответствующий обработчик
+        Node LoadStreamedDict(Buffer& input, const StreamHandlers& handlers) {
+            return LoadDictWith(input, [&handlers](const String& key, Buffer& input) -> std::optional<Node> {
+                const auto handler = handlers.find(std::string_view(key));
+                if (handler == handlers.end()) {
+                    return LoadNode(input);
+                }
+                Reader reader(input);
+                handler->second(reader);
+                return std::nullopt;
+                });
+        }
+
+        bool IsStructural(char c) {
+            return c == '"' || c == ',' || c == '[' || c == ']' || c == '{' || c == '}';
+        }
+
+        // Первый проход параллельного разбора: по буферу после открывающей скобки массива
+        // находит границы его элементов (запятые верхнего уровня и закрывающую скобку),
+        // не разбирая сами значения
+        std::vector<std::string_view> IndexArrayElements(Buffer& input) {
+            std::vector<std::string_view> elements;
+            const char* end = input.End();
+            const char* element_begin = input.Pos();
+            bool has_separator = false;
+            auto add_element = [&elements, &element_begin, &has_separator](const char* element_end, bool is_last) {
+                if (SkipSpaces(element_begin, element_end) != element_end) {
+                    elements.emplace_back(element_begin, static_cast<size_t>(element_end - element_begin));
+                }
+                else if (has_separator || !is_last) {
+                    // Пустой элемент допустим только в пустом массиве
+                    throw ParsingError("Array parsing error"s);
+                }
+                element_begin = element_end + 1;
+                has_separator = !is_last;
+                };
+
+            int depth = 0;
+            for (const char* pos = std::find_if(input.Pos(), end, IsStructural); pos != end;
+                pos = std::find_if(pos, end, IsStructural)) {
+                switch (*pos) {
+                case '"':
+                    // Пропускаем строку целиком, с учётом escape-последовательностей
+                    for (pos = FindStringSpecial(pos + 1, end); pos != end && *pos != '"';
+                        pos = FindStringSpecial(pos, end)) {
+                        pos += (*pos == '\\' && pos + 1 != end) ? 2 : 1;
+                    }
+                    if (pos == end) {
+                        throw ParsingError("String parsing error");
+                    }
+                    ++pos;
+                    break;
+                case '[':
+                case '{':
+                    ++depth;
+                    ++pos;
+                    break;
+                case ']':
+                case '}':
+                    if (depth == 0) {
+                        if (*pos != ']') {
+                            throw ParsingError("Array parsing error"s);
+                        }
+                        add_element(pos, true);
+                        input.MoveTo(pos + 1);
+                        return elements;
+                    }
+                    --depth;
+                    ++pos;
+                    break;
+                case ',':
+                    if (depth == 0) {
+                        add_element(pos, false);
+                    }
+                    ++pos;
+                    break;
+                }
+            }
+            throw ParsingError("Array parsing error"s);
+        }
+
+        // Разбирает подряд идущие элементы массива, разделённые запятыми
+        std::vector<Node> LoadArrayChunk(std::string_view chunk, std::pmr::memory_resource* arena) {
+            Buffer input(chunk, arena);
+            std::vector<Node> nodes;
+            for (char c; input.ReadNonSpace(c);) {
+                if (c != ',') {
+                    input.Unget();
+                }
+                nodes.push_back(LoadNode(input));
+            }
+            return nodes;
+        }
+
+        // Второй проход: элементы массива делятся на thread_count диапазонов, каждый
+        // разбирается в своём потоке и в своей арене. Арены добавляются в arenas
+        Node LoadParallelArray(Buffer& input, size_t thread_count, Document::Arenas& arenas) {
+            const std::vector<std::string_view> elements = IndexArrayElements(input);
+            const size_t chunk_count = std::min(thread_count, elements.size());
+
+            std::vector<std::future<std::vector<Node>>> chunks;
+            chunks.reserve(chunk_count);
+            for (size_t chunk = 0; chunk < chunk_count; ++chunk) {
+                const std::string_view first = elements[chunk * elements.size() / chunk_count];
+                const std::string_view last = elements[(chunk + 1) * elements.size() / chunk_count - 1];
+                const std::string_view text(first.data(), static_cast<size_t>(last.data() + last.size() - first.data()));
+                auto* arena = arenas.emplace_back(std::make_unique<std::pmr::monotonic_buffer_resource>()).get();
+                chunks.push_back(std::async(std::launch::async, LoadArrayChunk, text, arena));
+            }
+
+            Array result(input.Resource());
+            result.reserve(elements.size());
+            for (auto& chunk : chunks) {
+                for (Node& node : chunk.get()) {
+                    result.push_back(std::move(node));
+                }
+            }
+            return Node(std::move(result));
+        }
+
+        // Считывает строку после открывающей кавычки и дописывает её в s. Участки без
+        // escape-последовательностей находятся через FindStringSpecial и копируются целиком
+        void LoadStringTo(Buffer& input, String& s) {
             while (true) {
-                if (it == end) {
+                const char* special = FindStringSpecial(input.Pos(), input.End());
+                s.append(input.Pos(), special);
+                input.MoveTo(special);
+                if (input.Empty()) {
                     throw ParsingError("String parsing error");
                 }
-                const char ch = *it;
+                const char ch = input.Get();
                 if (ch == '"') {
-                    ++it;
                     break;
                 }
                 else if (ch == '\\') {
-                    ++it;
-                    if (it == end) {
+                    if (input.Empty()) {
                         throw ParsingError("String parsing error");
                     }
-                    const char escaped_char = *(it);
+                    const char escaped_char = input.Get();
                     switch (escaped_char) {
                     case 'n':
                         s.push_back('\n');
@@ -98,67 +436,81 @@ namespace json {
                         throw ParsingError("Unrecognized escape sequence \\"s + escaped_char);
                     }
                 }
-                else if (ch == '\n' || ch == '\r') {
-                    throw ParsingError("Unexpected end of line"s);
-                }
                 else {
-                    s.push_back(ch);
+                    // Перевод строки внутри строкового литерала
+                    throw ParsingError("Unexpected end of line"s);
                 }
-                ++it;
             }
+        }
 
-            return Node(std::move(s));
+        String LoadString(Buffer& input) {
+            String s(input.Resource());
+            LoadStringTo(input, s);
+            return s;
         }
 
-        Node LoadBool(std::istream& input) {
+        // Считывает строку после открывающей кавычки. Строка без escape-последовательностей
+        // возвращается как участок буфера, остальные собираются в scratch
+        std::string_view LoadStringView(Buffer& input, String& scratch) {
+            const char* begin = input.Pos();
+            const char* special = FindStringSpecial(begin, input.End());
+            if (special != input.End() && *special == '"') {
+                input.MoveTo(special + 1);
+                return { begin, static_cast<size_t>(special - begin) };
+            }
+            scratch.clear();
+            LoadStringTo(input, scratch);
+            return scratch;
+        }
+
+        bool ParseBool(Buffer& input) {
             const auto s = LoadLiteral(input);
             if (s == "true"sv) {
-                return Node{ true };
+                return true;
             }
             else if (s == "false"sv) {
-                return Node{ false };
+                return false;
             }
             else {
-                throw ParsingError("Failed to parse '"s + s + "' as bool"s);
+                throw ParsingError("Failed to parse '"s + std::string(s) + "' as bool"s);
             }
         }
 
-        Node LoadNull(std::istream& input) {
+        Node LoadBool(Buffer& input) {
+            return Node{ ParseBool(input) };
+        }
+
+        Node LoadNull(Buffer& input) {
             if (auto literal = LoadLiteral(input); literal == "null"sv) {
                 return Node{ nullptr };
             }
             else {
-                throw ParsingError("Failed to parse '"s + literal + "' as null"s);
+                throw ParsingError("Failed to parse '"s + std::string(literal) + "' as null"s);
             }
         }
 
-        Node LoadNumber(std::istream& input) {
-            std::string parsed_num;
+        // Число записано без дробной части и порядка и помещается в int - int, иначе double
+        using Number = std::variant<int, double>;
 
-            // Считывает в parsed_num очередной символ из input
-            auto read_char = [&parsed_num, &input] {
-                parsed_num += static_cast<char>(input.get());
-                if (!input) {
-                    throw ParsingError("Failed to read number from stream"s);
-                }
-                };
+        Number ParseNumber(Buffer& input) {
+            const char* begin = input.Pos();
 
-            // Считывает одну или более цифр в parsed_num из input
-            auto read_digits = [&input, read_char] {
-                if (!std::isdigit(input.peek())) {
+            // Считывает одну или более цифр из input
+            auto read_digits = [&input] {
+                if (!std::isdigit(input.Peek())) {
                     throw ParsingError("A digit is expected"s);
                 }
-                while (std::isdigit(input.peek())) {
-                    read_char();
+                while (std::isdigit(input.Peek())) {
+                    input.Get();
                 }
                 };
 
-            if (input.peek() == '-') {
-                read_char();
+            if (input.Peek() == '-') {
+                input.Get();
             }
             // Парсим целую часть числа
-            if (input.peek() == '0') {
-                read_char();
+            if (input.Peek() == '0') {
+                input.Get();
                 // После 0 в JSON не могут идти другие цифры
             }
             else {
@@ -167,43 +519,52 @@ namespace json {
 
             bool is_int = true;
             // Парсим дробную часть числа
-            if (input.peek() == '.') {
-                read_char();
+            if (input.Peek() == '.') {
+                input.Get();
                 read_digits();
                 is_int = false;
             }
 
             // Парсим экспоненциальную часть числа
-            if (int ch = input.peek(); ch == 'e' || ch == 'E') {
-                read_char();
-                if (ch = input.peek(); ch == '+' || ch == '-') {
-                    read_char();
+            if (int ch = input.Peek(); ch == 'e' || ch == 'E') {
+                input.Get();
+                if (ch = input.Peek(); ch == '+' || ch == '-') {
+                    input.Get();
                 }
                 read_digits();
                 is_int = false;
             }
 
-            try {
-                if (is_int) {
-                    // Сначала пробуем преобразовать строку в int
-                    try {
-                        return std::stoi(parsed_num);
-                    }
-                    catch (...) {
-                        // В случае неудачи, например, при переполнении
-                        // код ниже попробует преобразовать строку в double
-                    }
+            // std::from_chars не зависит от локали и не требует копирования числа в строку
+            const char* end = input.Pos();
+            if (is_int) {
+                int int_value = 0;
+                // При переполнении int код ниже попробует преобразовать число в double
+                if (const auto [ptr, ec] = std::from_chars(begin, end, int_value); ec == std::errc{} && ptr == end) {
+                    return int_value;
                 }
-                return std::stod(parsed_num);
             }
-            catch (...) {
-                throw ParsingError("Failed to convert "s + parsed_num + " to number"s);
+            double double_value = 0.0;
+            if (const auto [ptr, ec] = std::from_chars(begin, end, double_value); ec == std::errc{} && ptr == end) {
+                return double_value;
             }
+            throw ParsingError("Failed to convert "s + std::string(begin, end) + " to number"s);
         }
 
-        Node LoadNode(std::istream& input) {
+        Node LoadNumber(Buffer& input) {
+            return std::visit([](auto value) {
+                return Node(value);
+                }, ParseNumber(input));
+        }
+
+        // Символ, с которого LoadNode начинает разбор числа
+        bool IsNumberStart(char c) {
+            return c != '\0' && c != '[' && c != '{' && c != '"' && c != 't' && c != 'f' && c != 'n';
+        }
+
+        Node LoadNode(Buffer& input) {
             char c;
-            if (!(input >> c)) {
+            if (!input.ReadNonSpace(c)) {
                 throw ParsingError("Unexpected EOF"s);
             }
             switch (c) {
@@ -222,20 +583,130 @@ namespace json {
                 // литералов true либо false
                 [[fallthrough]];
             case 'f':
-                input.putback(c);
+                input.Unget();
                 return LoadBool(input);
             case 'n':
-                input.putback(c);
+                input.Unget();
                 return LoadNull(input);
             default:
-                input.putback(c);
+                input.Unget();
                 return LoadNumber(input);
             }
         }
 
+        // Бросает то же исключение, что и LoadDictWith, если ключ повторяется.
+        // Ищется первый по порядку ключ, встречавшийся раньше
+        void CheckDuplicateKeys(std::span<const std::string> keys) {
+            constexpr size_t LINEAR_SEARCH_LIMIT = 16;
+            const auto throw_duplicate = [](const std::string& key) {
+                throw ParsingError("Duplicate key '"s + key + "' have been found");
+            };
+            if (keys.size() <= LINEAR_SEARCH_LIMIT) {
+                for (auto it = keys.begin(); it != keys.end(); ++it) {
+                    if (std::find(keys.begin(), it, *it) != it) {
+                        throw_duplicate(*it);
+                    }
+                }
+                return;
+            }
+            std::unordered_set<std::string_view> seen;
+            for (const std::string& key : keys) {
+                if (!seen.insert(key).second) {
+                    throw_duplicate(key);
+                }
+            }
+        }
+
+        // Пропускает значение, не создавая узлов. Синтаксис и повторы ключей проверяются
+        // так же, как в LoadNode, поэтому ошибки совпадают с разбором в документ
+        class ValueSkipper {
+        public:
+            ValueSkipper(Buffer& input, std::vector<std::string>& keys, String& scratch)
+                : input_(input)
+                , keys_(keys)
+                , scratch_(scratch) {
+            }
+
+            void SkipNode() {
+                char c;
+                if (!input_.ReadNonSpace(c)) {
+                    throw ParsingError("Unexpected EOF"s);
+                }
+                switch (c) {
+                case '[':
+                    LoadArrayItems(input_, [this](Buffer&) {
+                        SkipNode();
+                        });
+                    break;
+                case '{':
+                    SkipDict();
+                    break;
+                case '"':
+                    LoadStringView(input_, scratch_);
+                    break;
+                case 't':
+                case 'f':
+                    input_.Unget();
+                    ParseBool(input_);
+                    break;
+                case 'n':
+                    input_.Unget();
+                    LoadNull(input_);
+                    break;
+                default:
+                    input_.Unget();
+                    ParseNumber(input_);
+                    break;
+                }
+            }
+
+        private:
+            // Повторяет LoadDictWith, но вместо узлов запоминает только ключи
+            void SkipDict() {
+                const size_t first_key = key_count_;
+                char c = 0;
+                bool closed = false;
+                while (input_.ReadNonSpace(c)) {
+                    if (c == '}') {
+                        closed = true;
+                        break;
+                    }
+                    if (c == '"') {
+                        const std::string_view key = LoadStringView(input_, scratch_);
+                        if (key_count_ == keys_.size()) {
+                            keys_.emplace_back();
+                        }
+                        keys_[key_count_++].assign(key);
+                        if (input_.ReadNonSpace(c) && c == ':') {
+                            SkipNode();
+                        }
+                        else {
+                            throw ParsingError(": is expected but '"s + c + "' has been found"s);
+                        }
+                    }
+                    else if (c != ',') {
+                        throw ParsingError(R"(',' is expected but ')"s + c + "' has been found"s);
+                    }
+                }
+                if (!closed) {
+                    throw ParsingError("Dictionary parsing error"s);
+                }
+                CheckDuplicateKeys(std::span(keys_).subspan(first_key, key_count_ - first_key));
+                key_count_ = first_key;
+            }
+
+            Buffer& input_;
+            // Стек ключей открытых словарей: первые key_count_ строк
+            std::vector<std::string>& keys_;
+            size_t key_count_ = 0;
+            String& scratch_;
+        };
+
+        constexpr int INDENT_STEP = 4;
+
         struct PrintContext {
             std::ostream& out;
-            int indent_step = 4;
+            int indent_step = INDENT_STEP;
             int indent = 0;
 
             void PrintIndent() const {
@@ -256,7 +727,23 @@ namespace json {
             ctx.out << value;
         }
 
-        void PrintString(const std::string& value, std::ostream& out) {
+        // Числа форматируются через std::to_chars в буфер на стеке.
+        // Формат double общий с svg и описан в number_format.h
+        template <>
+        void PrintValue<int>(const int& value, const PrintContext& ctx) {
+            std::array<char, 16> buffer;
+            const auto result = std::to_chars(buffer.data(), buffer.data() + buffer.size(), value);
+            ctx.out.write(buffer.data(), result.ptr - buffer.data());
+        }
+
+        template <>
+        void PrintValue<double>(const double& value, const PrintContext& ctx) {
+            number_format::DoubleBuffer buffer;
+            const std::string_view text = number_format::FormatDouble(value, ctx.out.precision(), buffer);
+            ctx.out.write(text.data(), static_cast<std::streamsize>(text.size()));
+        }
+
+        void PrintString(std::string_view value, std::ostream& out) {
             out.put('"');
             for (const char c : value) {
                 switch (c) {
@@ -284,7 +771,7 @@ namespace json {
         }
 
         template <>
-        void PrintValue<std::string>(const std::string& value, const PrintContext& ctx) {
+        void PrintValue<String>(const String& value, const PrintContext& ctx) {
             PrintString(value, ctx.out);
         }
 
@@ -356,12 +843,320 @@ namespace json {
 
     }  // namespace
 
+    Reader::Reader(detail::Buffer& input)
+        : input_(input)
+        , scratch_(scratch_buffer_.data(), scratch_buffer_.size()) {
+    }
+
+    void Reader::StartDict() {
+        if (char c = 0; !input_.ReadNonSpace(c) || c != '{') {
+            throw ParsingError("Dictionary is expected"s);
+        }
+    }
+
+    bool Reader::NextKey(std::string_view& key) {
+        char c = 0;
+        while (input_.ReadNonSpace(c)) {
+            if (c == '}') {
+                return false;
+            }
+            if (c == '"') {
+                key = LoadStringView(input_, key_);
+                if (!input_.ReadNonSpace(c) || c != ':') {
+                    throw ParsingError(": is expected after key '"s + std::string(key) + "'"s);
+                }
+                return true;
+            }
+            if (c != ',') {
+                throw ParsingError(R"(',' is expected but ')"s + c + "' has been found"s);
+            }
+        }
+        throw ParsingError("Dictionary parsing error"s);
+    }
+
+    void Reader::StartArray() {
+        if (char c = 0; !input_.ReadNonSpace(c) || c != '[') {
+            throw ParsingError("Array is expected"s);
+        }
+    }
+
+    bool Reader::NextItem() {
+        char c = 0;
+        if (!input_.ReadNonSpace(c)) {
+            throw ParsingError("Array parsing error"s);
+        }
+        if (c == ']') {
+            return false;
+        }
+        if (c != ',') {
+            input_.Unget();
+        }
+        return true;
+    }
+
+    std::string_view Reader::ReadString() {
+        if (char c = 0; !input_.ReadNonSpace(c) || c != '"') {
+            throw ParsingError("String is expected"s);
+        }
+        return LoadStringView(input_, value_);
+    }
+
+    char Reader::PeekValueStart() {
+        char c = 0;
+        if (!input_.ReadNonSpace(c)) {
+            return '\0';
+        }
+        input_.Unget();
+        return c;
+    }
+
+    // Значение другого типа разбирается в узел только ради того же исключения,
+    // что и у Node::AsInt, AsDouble и AsBool при разборе в документ
+    int Reader::ReadInt() {
+        if (!IsNumberStart(PeekValueStart())) {
+            return ReadNode().AsInt();
+        }
+        const Number number = ParseNumber(input_);
+        if (const int* value = std::get_if<int>(&number)) {
+            return *value;
+        }
+        throw std::logic_error("Not an int"s);
+    }
+
+    double Reader::ReadDouble() {
+        if (!IsNumberStart(PeekValueStart())) {
+            return ReadNode().AsDouble();
+        }
+        return std::visit([](auto value) {
+            return static_cast<double>(value);
+            }, ParseNumber(input_));
+    }
+
+    bool Reader::ReadBool() {
+        if (const char c = PeekValueStart(); c != 't' && c != 'f') {
+            return ReadNode().AsBool();
+        }
+        return ParseBool(input_);
+    }
+
+    Node Reader::ReadNode() {
+        // Предыдущий узел больше не нужен, и арена переиспользуется целиком
+        scratch_.release();
+        std::pmr::memory_resource* document_resource = input_.SetResource(&scratch_);
+        const size_t array_items = input_.ArrayItems().size();
+        const size_t dict_items = input_.DictItems().size();
+        try {
+            Node node = LoadNode(input_);
+            input_.SetResource(document_resource);
+            return node;
+        }
+        catch (...) {
+            // Недоразобранные элементы размещены во временной арене и не должны её пережить
+            input_.ArrayItems().erase(input_.ArrayItems().begin() + array_items, input_.ArrayItems().end());
+            input_.DictItems().erase(input_.DictItems().begin() + dict_items, input_.DictItems().end());
+            input_.SetResource(document_resource);
+            throw;
+        }
+    }
+
+    void Reader::SkipValue() {
+        ValueSkipper(input_, skipped_keys_, value_).SkipNode();
+    }
+
+    Document Load(std::string_view input) {
+        TRACE_SCOPE("json::Load");
+        auto arena = std::make_unique<std::pmr::monotonic_buffer_resource>();
+        Buffer buffer(input, arena.get());
+        Node root = LoadNode(buffer);
+        return Document{ std::move(root), std::move(arena) };
+    }
+
+    Document Load(std::string_view input, const StreamHandlers& handlers) {
+        TRACE_SCOPE("json::Load");
+        auto arena = std::make_unique<std::pmr::monotonic_buffer_resource>();
+        Buffer buffer(input, arena.get());
+        char c = 0;
+        if (!buffer.ReadNonSpace(c) || c != '{') {
+            throw ParsingError("Root dictionary is expected"s);
+        }
+        Node root = LoadStreamedDict(buffer, handlers);
+        return Document{ std::move(root), std::move(arena) };
+    }
+
+    Document LoadParallel(std::string_view input, size_t thread_count) {
+        TRACE_SCOPE("json::LoadParallel");
+        if (thread_count == 0) {
+            thread_count = std::max(1u, std::thread::hardware_concurrency());
+        }
+        Document::Arenas arenas;
+        arenas.push_back(std::make_unique<std::pmr::monotonic_buffer_resource>());
+        Buffer buffer(input, arenas.front().get());
+
+        char c = 0;
+        if (!buffer.ReadNonSpace(c) || c != '{') {
+            throw ParsingError("Root dictionary is expected"s);
+        }
+        Node root = LoadDictWith(buffer, [thread_count, &arenas](const String&, Buffer& input) -> std::optional<Node> {
+            char c = 0;
+            if (!input.ReadNonSpace(c)) {
+                throw ParsingError("Unexpected EOF"s);
+            }
+            if (c == '[') {
+                return LoadParallelArray(input, thread_count, arenas);
+            }
+            input.Unget();
+            return LoadNode(input);
+            });
+        return Document{ std::move(root), std::move(arenas) };
+    }
+
+    Document LoadParallel(std::istream& input, size_t thread_count) {
+        const std::string data{ std::istreambuf_iterator<char>(input), std::istreambuf_iterator<char>() };
+        return LoadParallel(std::string_view(data), thread_count);
+    }
+
+    Document Load(std::istream& input, const StreamHandlers& handlers) {
+        const std::string data{ std::istreambuf_iterator<char>(input), std::istreambuf_iterator<char>() };
+        return Load(std::string_view(data), handlers);
+    }
+
     Document Load(std::istream& input) {
-        return Document{ LoadNode(input) };
+        // Поток вычитывается целиком одним блоком, дальше разбор идёт по памяти
+        const std::string data{ std::istreambuf_iterator<char>(input), std::istreambuf_iterator<char>() };
+        return Load(std::string_view(data));
     }
 
     void Print(const Document& doc, std::ostream& output) {
+        TRACE_SCOPE("json::Print");
         PrintNode(doc.GetRoot(), PrintContext{ output });
     }
 
+    Writer::Writer(std::ostream& output, int indent)
+        : output_(output)
+        , indent_(indent) {
+    }
+
+    int Writer::Indent() const {
+        return indent_ + INDENT_STEP * static_cast<int>(frames_.size());
+    }
+
+    void Writer::BeforeValue() {
+        if (frames_.empty()) {
+            return;
+        }
+        Frame& frame = frames_.back();
+        if (frame.is_dict) {
+            if (!key_written_) {
+                throw std::logic_error("value without key"s);
+            }
+            key_written_ = false;
+            return;
+        }
+        output_ << (frame.empty ? "\n"sv : ",\n"sv);
+        frame.empty = false;
+        PrintContext{ output_, INDENT_STEP, Indent() }.PrintIndent();
+    }
+
+    void Writer::EndContainer(bool is_dict, char close) {
+        if (frames_.empty() || frames_.back().is_dict != is_dict || key_written_) {
+            throw std::logic_error(is_dict ? "wrong end of dict"s : "wrong end of array"s);
+        }
+        if (frames_.back().empty) {
+            // Print выводит пустой контейнер с пустой строкой внутри
+            output_.put('\n');
+        }
+        frames_.pop_back();
+        output_.put('\n');
+        PrintContext{ output_, INDENT_STEP, Indent() }.PrintIndent();
+        output_.put(close);
+    }
+
+    Writer& Writer::StartDict() {
+        BeforeValue();
+        output_.put('{');
+        frames_.push_back({ true });
+        return *this;
+    }
+
+    Writer& Writer::EndDict() {
+        EndContainer(true, '}');
+        return *this;
+    }
+
+    Writer& Writer::StartArray() {
+        BeforeValue();
+        output_.put('[');
+        frames_.push_back({ false });
+        return *this;
+    }
+
+    Writer& Writer::EndArray() {
+        EndContainer(false, ']');
+        return *this;
+    }
+
+    Writer& Writer::Key(std::string_view key) {
+        if (frames_.empty() || !frames_.back().is_dict || key_written_) {
+            throw std::logic_error("key error"s);
+        }
+        Frame& frame = frames_.back();
+        output_ << (frame.empty ? "\n"sv : ",\n"sv);
+        frame.empty = false;
+        PrintContext{ output_, INDENT_STEP, Indent() }.PrintIndent();
+        PrintString(key, output_);
+        output_ << ": "sv;
+        key_written_ = true;
+        return *this;
+    }
+
+    Writer& Writer::Value(std::nullptr_t) {
+        BeforeValue();
+        PrintValue(nullptr, PrintContext{ output_ });
+        return *this;
+    }
+
+    Writer& Writer::Value(bool value) {
+        BeforeValue();
+        PrintValue(value, PrintContext{ output_ });
+        return *this;
+    }
+
+    Writer& Writer::Value(int value) {
+        BeforeValue();
+        PrintValue(value, PrintContext{ output_ });
+        return *this;
+    }
+
+    Writer& Writer::Value(double value) {
+        BeforeValue();
+        PrintValue(value, PrintContext{ output_ });
+        return *this;
+    }
+
+    Writer& Writer::Value(std::string_view value) {
+        BeforeValue();
+        PrintString(value, output_);
+        return *this;
+    }
+
+    Writer& Writer::Value(const char* value) {
+        return Value(std::string_view(value));
+    }
+
+    Writer& Writer::Value(const std::string& value) {
+        return Value(std::string_view(value));
+    }
+
+    Writer& Writer::Value(const Node& node) {
+        BeforeValue();
+        PrintNode(node, PrintContext{ output_, INDENT_STEP, Indent() });
+        return *this;
+    }
+
+    Writer& Writer::RawValue(std::string_view json) {
+        BeforeValue();
+        output_ << json;
+        return *this;
+    }
+
 }  // namespace json
\ No newline at end of file
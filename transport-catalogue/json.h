@@ -1,16 +1,85 @@
 #pragma once
 
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <functional>
 #include <iostream>
 #include <map>
+#include <memory>
+#include <memory_resource>
+#include <stdexcept>
 #include <string>
+#include <string_view>
+#include <utility>
 #include <variant>
 #include <vector>
 
 namespace json {
 
     class Node;
-    using Dict = std::map<std::string, Node>;
-    using Array = std::vector<Node>;
+
+    // Контейнеры документа берут память из std::pmr::memory_resource.
+    // json::Load выделяет весь документ из одной арены, а узлы, созданные вне Load,
+    // используют ресурс по умолчанию (обычные new/delete)
+    using Array = std::pmr::vector<Node>;
+    using String = std::pmr::string;
+
+    // Словарь в виде отсортированного по ключу вектора пар.
+    // Объекты во входных данных небольшие (4-5 ключей), поэтому бинарный поиск
+    // по непрерывному массиву дешевле дерева с отдельной аллокацией на каждый ключ.
+    // Поиск принимает std::string_view и не создаёт временных строк
+    class Dict {
+    public:
+        using value_type = std::pair<String, Node>;
+        using iterator = std::pmr::vector<value_type>::iterator;
+        using const_iterator = std::pmr::vector<value_type>::const_iterator;
+
+        Dict() = default;
+        explicit Dict(std::pmr::memory_resource* resource)
+            : items_(resource) {
+        }
+
+        iterator begin() {
+            return items_.begin();
+        }
+        iterator end() {
+            return items_.end();
+        }
+        const_iterator begin() const {
+            return items_.begin();
+        }
+        const_iterator end() const {
+            return items_.end();
+        }
+
+        size_t size() const {
+            return items_.size();
+        }
+        bool empty() const {
+            return items_.empty();
+        }
+        void reserve(size_t capacity) {
+            items_.reserve(capacity);
+        }
+
+        iterator find(std::string_view key);
+        const_iterator find(std::string_view key) const;
+        size_t count(std::string_view key) const;
+        const Node& at(std::string_view key) const;
+
+        // Как и у std::map, существующее значение не перезаписывается
+        std::pair<iterator, bool> emplace(String key, Node value);
+        Node& operator[](std::string_view key);
+
+        bool operator==(const Dict& rhs) const;
+
+    private:
+        iterator LowerBound(std::string_view key);
+        const_iterator LowerBound(std::string_view key) const;
+
+        std::pmr::vector<value_type> items_;
+    };
 
     class ParsingError : public std::runtime_error {
     public:
@@ -19,7 +88,7 @@ namespace json {
 
     class Node final {
     public:
-        using Value = std::variant<std::nullptr_t, Array, Dict, bool, int, double, std::string>;
+        using Value = std::variant<std::nullptr_t, Array, Dict, bool, int, double, String>;
 
         Node() = default;
         Node(std::nullptr_t)
@@ -31,9 +100,12 @@ namespace json {
         Node(double val)
             : value_(val) {
         }
-        Node(std::string val)
+        Node(String val)
             : value_(std::move(val)) {
         }
+        Node(const std::string& val)
+            : value_(String(val.data(), val.size())) {
+        }
         Node(Array val)
             : value_(std::move(val)) {
         }
@@ -98,15 +170,15 @@ namespace json {
         }
 
         bool IsString() const {
-            return std::holds_alternative<std::string>(value_);
+            return std::holds_alternative<String>(value_);
         }
-        const std::string& AsString() const {
+        const String& AsString() const {
             using namespace std::literals;
             if (!IsString()) {
                 throw std::logic_error("Not a string"s);
             }
 
-            return std::get<std::string>(value_);
+            return std::get<String>(value_);
         }
 
         bool IsMap() const {
@@ -137,17 +209,88 @@ namespace json {
         return !(lhs == rhs);
     }
 
+    inline Dict::iterator Dict::LowerBound(std::string_view key) {
+        return std::lower_bound(items_.begin(), items_.end(), key, [](const value_type& item, std::string_view key) {
+            return item.first < key;
+            });
+    }
+
+    inline Dict::const_iterator Dict::LowerBound(std::string_view key) const {
+        return std::lower_bound(items_.begin(), items_.end(), key, [](const value_type& item, std::string_view key) {
+            return item.first < key;
+            });
+    }
+
+    inline Dict::iterator Dict::find(std::string_view key) {
+        const auto it = LowerBound(key);
+        return it != items_.end() && it->first == key ? it : items_.end();
+    }
+
+    inline Dict::const_iterator Dict::find(std::string_view key) const {
+        const auto it = LowerBound(key);
+        return it != items_.end() && it->first == key ? it : items_.end();
+    }
+
+    inline size_t Dict::count(std::string_view key) const {
+        return find(key) != items_.end() ? 1 : 0;
+    }
+
+    inline const Node& Dict::at(std::string_view key) const {
+        using namespace std::literals;
+        const auto it = find(key);
+        if (it == items_.end()) {
+            throw std::out_of_range("Key '"s + std::string(key) + "' not found"s);
+        }
+        return it->second;
+    }
+
+    inline std::pair<Dict::iterator, bool> Dict::emplace(String key, Node value) {
+        const auto it = LowerBound(key);
+        if (it != items_.end() && it->first == key) {
+            return { it, false };
+        }
+        return { items_.emplace(it, std::move(key), std::move(value)), true };
+    }
+
+    inline Node& Dict::operator[](std::string_view key) {
+        if (const auto it = LowerBound(key); it != items_.end() && it->first == key) {
+            return it->second;
+        }
+        return emplace(String(key, items_.get_allocator()), Node{}).first->second;
+    }
+
+    inline bool Dict::operator==(const Dict& rhs) const {
+        return items_ == rhs.items_;
+    }
+
     class Document {
     public:
+        using Arenas = std::vector<std::unique_ptr<std::pmr::memory_resource>>;
+
         explicit Document(Node root)
             : root_(std::move(root)) {
         }
 
+        // Документ, узлы которого размещены в арене arena. Арена освобождается
+        // целиком вместе с документом
+        Document(Node root, std::unique_ptr<std::pmr::memory_resource> arena)
+            : root_(std::move(root)) {
+            arenas_.push_back(std::move(arena));
+        }
+
+        // То же для документа, части которого разобраны в разных аренах
+        Document(Node root, Arenas arenas)
+            : arenas_(std::move(arenas))
+            , root_(std::move(root)) {
+        }
+
         const Node& GetRoot() const {
             return root_;
         }
 
     private:
+        // Арены объявлены до корня, чтобы пережить его при разрушении документа
+        Arenas arenas_;
         Node root_;
     };
 
@@ -159,8 +302,128 @@ namespace json {
         return !(lhs == rhs);
     }
 
+    // Разбирает документ из непрерывного буфера (например, отображённого в память файла)
+    Document Load(std::string_view input);
     Document Load(std::istream& input);
 
+    namespace detail {
+        class Buffer;
+    }
+
+    // Последовательное чтение значений прямо из входного буфера, без построения узлов.
+    // Нужно декодерам записей с заранее известной структурой. Ключи и строки возвращаются
+    // как std::string_view, действительный до следующего вызова того же метода.
+    // Небольшие значения переменной структуры (цвета, координаты) читаются целиком через
+    // ReadNode, ненужные значения пропускаются через SkipValue
+    class Reader {
+    public:
+        explicit Reader(detail::Buffer& input);
+
+        Reader(const Reader&) = delete;
+        Reader& operator=(const Reader&) = delete;
+
+        // NextKey считывает очередной ключ вместе с двоеточием
+        // и возвращает false на закрывающей скобке словаря
+        void StartDict();
+        bool NextKey(std::string_view& key);
+
+        // NextItem возвращает false на закрывающей скобке массива
+        void StartArray();
+        bool NextItem();
+
+        // Числа и литералы разбираются без создания узла. Значение другого типа
+        // приводит к тем же исключениям, что и Node::AsInt, AsDouble и AsBool
+        std::string_view ReadString();
+        int ReadInt();
+        double ReadDouble();
+        bool ReadBool();
+
+        // Узел размещается во временной арене Reader, а не в арене документа,
+        // и действителен до следующего вызова ReadNode
+        Node ReadNode();
+
+        // Пропускает значение, проверяя его так же, как при разборе в узел
+        void SkipValue();
+
+    private:
+        // Пропускает пробелы и возвращает первый символ следующего значения,
+        // не извлекая его, или '\0' в конце буфера
+        char PeekValueStart();
+
+        detail::Buffer& input_;
+        String key_;
+        String value_;
+        // Ключи словарей, открытых внутри пропускаемого значения, для поиска повторов.
+        // Строки переиспользуются между вызовами SkipValue
+        std::vector<std::string> skipped_keys_;
+        // Небольшие значения помещаются в буфер целиком и не обращаются к куче
+        std::array<std::byte, 1024> scratch_buffer_;
+        std::pmr::monotonic_buffer_resource scratch_;
+    };
+
+    // Потоковая загрузка: значения корневого словаря, ключи которых есть в handlers,
+    // читает соответствующий обработчик, и в документ они не попадают.
+    // Обработчик должен прочитать из Reader ровно одно значение
+    using ValueHandler = std::function<void(Reader&)>;
+    using StreamHandlers = std::map<std::string, ValueHandler, std::less<>>;
+
+    Document Load(std::string_view input, const StreamHandlers& handlers);
+    Document Load(std::istream& input, const StreamHandlers& handlers);
+
+    // Параллельная загрузка: массивы корневого словаря сначала размечаются на элементы
+    // без разбора значений, затем диапазоны элементов разбираются на thread_count потоках
+    // (0 - по числу ядер). Результат совпадает с Load(input)
+    Document LoadParallel(std::string_view input, size_t thread_count = 0);
+    Document LoadParallel(std::istream& input, size_t thread_count = 0);
+
     void Print(const Document& doc, std::ostream& output);
 
+    // Записывает JSON прямо в выходной поток, не строя дерево узлов.
+    // Формат совпадает с выводом Print. Print выводит ключи словаря по возрастанию,
+    // поэтому для совпадения вывода ключи нужно передавать в том же порядке.
+    // Нарушение вложенности (значение без ключа в словаре, закрытие не того контейнера)
+    // приводит к исключению std::logic_error, как и в json::Builder
+    class Writer {
+    public:
+        // indent - отступ, с которого начинается запись (например, для элемента массива)
+        explicit Writer(std::ostream& output, int indent = 0);
+
+        Writer& StartDict();
+        Writer& EndDict();
+        Writer& StartArray();
+        Writer& EndArray();
+        Writer& Key(std::string_view key);
+
+        Writer& Value(std::nullptr_t);
+        Writer& Value(bool value);
+        Writer& Value(int value);
+        Writer& Value(double value);
+        Writer& Value(std::string_view value);
+        Writer& Value(const char* value);
+        Writer& Value(const std::string& value);
+        Writer& Value(const Node& node);
+
+        // Вставляет значение, уже записанное в формате JSON другим Writer,
+        // созданным с отступом Indent(). Содержимое не проверяется
+        Writer& RawValue(std::string_view json);
+
+        // Отступ, с которым записывается очередное значение
+        int Indent() const;
+
+    private:
+        struct Frame {
+            bool is_dict = false;
+            bool empty = true;
+        };
+
+        // Готовит поток к записи очередного значения: разделитель, отступ, проверки
+        void BeforeValue();
+        void EndContainer(bool is_dict, char close);
+
+        std::ostream& output_;
+        int indent_;
+        std::vector<Frame> frames_;
+        bool key_written_ = false;
+    };
+
 }  // namespace json
\ No newline at end of file
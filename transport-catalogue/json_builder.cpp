@@ -1,4 +1,5 @@
 #include <algorithm>
+#include <iterator>
 #include <variant>
 #include <vector>
 #include <string>
@@ -12,7 +13,7 @@ namespace json {
 			return ArrayItemContext(builder_);
 		}
 		DictItemContext KeyContext::Value(Node val) {
-			builder_->Value(val);
+			builder_->Value(std::move(val));
 			return DictItemContext(builder_);
 		}
 		DictItemContext KeyContext::StartDict() {
@@ -22,7 +23,7 @@ namespace json {
 
 
 		KeyContext DictItemContext::Key(std::string key) {
-			builder_->Key(key);
+			builder_->Key(std::move(key));
 			return detail::KeyContext(builder_);
 		}
 		Builder& DictItemContext::EndDict() {
@@ -43,18 +44,18 @@ namespace json {
 		}
 
 		ArrayItemContext& ArrayItemContext::Value(Node val) {
-			builder_->Value(val);
+			builder_->Value(std::move(val));
 			return *this;
 		}
 	}
 
 	bool Builder::CheckObjectCompleted() {
 		if (nodes_stack_.size() == 1) {
-			if (!(nodes_stack_.top().IsArray() &&
-				nodes_stack_.top().AsArray().empty())) {
+			if (!(nodes_stack_.back().IsArray() &&
+				nodes_stack_.back().AsArray().empty())) {
 
-				if (!(nodes_stack_.top().AsMap().empty() &&
-					nodes_stack_.top().AsMap().empty())) {
+				if (!(nodes_stack_.back().AsMap().empty() &&
+					nodes_stack_.back().AsMap().empty())) {
 
 					return true;
 				}
@@ -68,8 +69,9 @@ namespace json {
 			return false;
 		}
 
-		if (!main_nodes_stack_.back()->IsArray()) {
-			if (!main_nodes_stack_.back()->IsMap()) {
+		const Node& container = nodes_stack_[main_nodes_stack_.back()];
+		if (!container.IsArray()) {
+			if (!container.IsMap()) {
 				return true;
 			}
 			else {
@@ -91,7 +93,7 @@ namespace json {
 			if (CheckObjectCompleted()) {
 				throw std::logic_error("the object is completed");
 			}
-			key_.push(key);
+			key_.push_back(std::move(key));
 		}
 		return detail::KeyContext(this);
 	}
@@ -111,11 +113,11 @@ namespace json {
 
 		last_key_is_empty_ = false;
 
-		nodes_stack_.push(val);
+		nodes_stack_.push_back(std::move(val));
 		return *this;
 	}
 
-	void Builder::StartObject(const Node&& obj) {
+	void Builder::StartObject(Node&& obj) {
 		if (CheckObjectCompleted()) {
 			throw std::logic_error("the object is completed");
 		}
@@ -126,20 +128,20 @@ namespace json {
 
 		last_key_is_empty_ = false;
 
-		nodes_stack_.push(std::move(obj));
-		main_nodes_stack_.push_back(&nodes_stack_.top());
+		main_nodes_stack_.push_back(nodes_stack_.size());
+		nodes_stack_.push_back(std::move(obj));
 	}
 
 	detail::DictItemContext Builder::StartDict() {
 		++depth_of_dicts;
 
-		StartObject(move(Dict()));
+		StartObject(Dict());
 
 		return detail::DictItemContext(this);
 	}
 
 	detail::ArrayItemContext Builder::StartArray() {
-		StartObject(move(Array()));
+		StartObject(Array());
 
 		return detail::ArrayItemContext(this);
 	}
@@ -149,7 +151,7 @@ namespace json {
 			throw std::logic_error("the object is completed");
 		}
 		//проверка на неверное закрытие
-		if (main_nodes_stack_.back()->IsArray()) {
+		if (nodes_stack_[main_nodes_stack_.back()].IsArray()) {
 			throw std::logic_error("wrong end of array");
 			return*this;
 		}
@@ -157,24 +159,26 @@ namespace json {
 		--depth_of_dicts;
 		double_key_check = depth_of_dicts;
 
+		const size_t dict_index = main_nodes_stack_.back();
+		const size_t values_count = nodes_stack_.size() - dict_index - 1;
+		const size_t keys_count = values_count + (last_key_is_empty_ ? 1 : 0);
 
 		Dict dict;
+		dict.reserve(keys_count);
+		//ключи и значения лежат в стеках в порядке добавления
+		auto key = key_.end() - keys_count;
+		for (size_t i = dict_index + 1; i < nodes_stack_.size(); ++i, ++key) {
+			dict.emplace(String(key->data(), key->size()), std::move(nodes_stack_[i]));
+		}
 		if (last_key_is_empty_) {
 			double_key_check = depth_of_dicts;
-			dict[key_.top()] = nullptr;
-			key_.pop();
-		}
-		while (!nodes_stack_.empty()) {
-			if (main_nodes_stack_.back() == &(nodes_stack_.top())) {
-				main_nodes_stack_.pop_back();
-				nodes_stack_.pop();
-				nodes_stack_.push(move(dict));
-				break;
-			}
-			dict[key_.top()] = nodes_stack_.top();
-			key_.pop();
-			nodes_stack_.pop();
+			dict.emplace(String(key->data(), key->size()), nullptr);
 		}
+		key_.erase(key_.end() - keys_count, key_.end());
+
+		nodes_stack_.resize(dict_index);
+		main_nodes_stack_.pop_back();
+		nodes_stack_.push_back(std::move(dict));
 		return *this;
 	}
 
@@ -184,23 +188,19 @@ namespace json {
 			throw std::logic_error("the object is completed");
 		}
 		//проверка на неверное закрытие
-		if (main_nodes_stack_.back()->IsMap()) {
+		if (nodes_stack_[main_nodes_stack_.back()].IsMap()) {
 			throw std::logic_error("wrong end of array");
 			return *this;
 		}
+
+		const size_t array_index = main_nodes_stack_.back();
 		Array result;
+		result.reserve(nodes_stack_.size() - array_index - 1);
+		std::move(nodes_stack_.begin() + array_index + 1, nodes_stack_.end(), std::back_inserter(result));
 
-		while (!nodes_stack_.empty()) {
-			if (main_nodes_stack_.back() == &(nodes_stack_.top())) {
-				main_nodes_stack_.pop_back();
-				nodes_stack_.pop();
-				reverse(result.begin(), result.end());
-				nodes_stack_.push(move(result));
-				break;
-			}
-			result.push_back(nodes_stack_.top());
-			nodes_stack_.pop();
-		}
+		nodes_stack_.resize(array_index);
+		main_nodes_stack_.pop_back();
+		nodes_stack_.push_back(std::move(result));
 
 		return *this;
 	}
@@ -212,9 +212,9 @@ namespace json {
 		else if (nodes_stack_.size() > 1) {
 			throw std::logic_error("incomplete array or dictionary");
 		}
-		else {
-			root_ = nodes_stack_.top();
-		}
-		return root_;
+		//готовый объект отдаётся перемещением, повторный Build бросит исключение
+		Node root = std::move(nodes_stack_.back());
+		nodes_stack_.clear();
+		return root;
 	}
 }
\ No newline at end of file
@@ -1,5 +1,5 @@
 #pragma once
-#include <stack>
+#include <string>
 #include <vector>
 #include "json.h"
 
@@ -11,6 +11,8 @@ namespace json {
         class DictItemContext;
         class ArrayItemContext;
 
+        // Значения и ключи принимаются по значению и перемещаются дальше в Builder,
+        // поэтому переданный rvalue не копируется ни разу
         class KeyContext {
         public:
             KeyContext(Builder* builder) :builder_(builder) {
@@ -56,14 +58,14 @@ namespace json {
         Node Build();
 
     private:
-        std::stack <std::string> key_;
-        bool begin_arr_ = false;
-        bool begin_daict_ = false;
-        Node root_;
-        std::stack<Node> nodes_stack_;
-        std::vector<Node*> main_nodes_stack_;
+        std::vector<std::string> key_;
+        // Готовые значения и открытые контейнеры. Элементы контейнера лежат в стеке
+        // после него и собираются в контейнер нужного размера при его закрытии
+        std::vector<Node> nodes_stack_;
+        // Индексы открытых контейнеров в nodes_stack_
+        std::vector<size_t> main_nodes_stack_;
 
-        void StartObject(const Node&&);
+        void StartObject(Node&&);
 
         int depth_of_dicts = 0;//текущее количество вложенных словарей
         int double_key_check = 0;//количество открытых ключей без значения
@@ -1,4 +1,13 @@
 #include "json_reader.h"
+#include "tracing.h"
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <vector>
 
 /*
  * Здесь можно разместить код наполнения транспортного справочника данными из JSON,
@@ -6,97 +15,620 @@
  */
 
 namespace json_reader {
-    void JsonReader::LoadDataToCatalogue() {
-        const json::Array& arr = GetBaseRequests().AsArray();
-        for (auto& request_stops : arr) {
-            const auto& request_stops_map = request_stops.AsMap();
-            const auto& type = request_stops_map.at("type").AsString();
-            if (type == "Stop") {
-                LoadStop(request_stops_map);
+
+    namespace {
+        using namespace std::literals;
+
+        // Таблица ключей записи с идеальным хешированием. Размер таблицы, при котором
+        // хеши всех ключей попадают в разные ячейки, подбирается на этапе компиляции.
+        // Поиск ключа - одно вычисление хеша и одно сравнение строк.
+        // Key - перечисление ключей, последний элемент которого UNKNOWN
+        template <typename Key>
+        class KeyTable {
+        public:
+            static constexpr size_t KEY_COUNT = static_cast<size_t>(Key::UNKNOWN);
+
+            // Если подходящий размер таблицы не найден, исключение
+            // при вычислении constexpr-переменной даст ошибку компиляции
+            constexpr explicit KeyTable(const std::array<std::string_view, KEY_COUNT>& keys)
+                : keys_(keys) {
+                for (size_t size = KEY_COUNT; size <= MAX_SIZE; ++size) {
+                    if (Fill(size)) {
+                        size_ = size;
+                        return;
+                    }
+                }
+                throw std::logic_error("perfect hash is not found");
+            }
+
+            Key Find(std::string_view key) const {
+                const size_t index = slots_[Hash(key) % size_];
+                return index < KEY_COUNT && keys_[index] == key ? static_cast<Key>(index) : Key::UNKNOWN;
+            }
+
+            constexpr std::string_view Name(Key key) const {
+                return keys_[static_cast<size_t>(key)];
+            }
+
+        private:
+            static constexpr size_t MAX_SIZE = 64;
+
+            // FNV-1a
+            static constexpr uint32_t Hash(std::string_view key) {
+                uint32_t hash = 2166136261u;
+                for (const char c : key) {
+                    hash = (hash ^ static_cast<unsigned char>(c)) * 16777619u;
+                }
+                return hash;
+            }
+
+            constexpr bool Fill(size_t size) {
+                for (auto& slot : slots_) {
+                    slot = KEY_COUNT;
+                }
+                for (size_t index = 0; index < KEY_COUNT; ++index) {
+                    auto& slot = slots_[Hash(keys_[index]) % size];
+                    if (slot != KEY_COUNT) {
+                        return false;
+                    }
+                    slot = static_cast<uint8_t>(index);
+                }
+                return true;
+            }
+
+            std::array<std::string_view, KEY_COUNT> keys_;
+            std::array<uint8_t, MAX_SIZE> slots_{};
+            size_t size_ = 0;
+        };
+
+        // Ключи, встреченные в записи. Декодеры проверяют записи так же, как чтение из
+        // документа: повтор ключа - json::ParsingError, как у json::Load, отсутствие
+        // обязательного ключа - std::out_of_range, как у json::Dict::at
+        template <typename Key>
+        class SeenKeys {
+        public:
+            static_assert(KeyTable<Key>::KEY_COUNT <= 32);
+
+            explicit SeenKeys(const KeyTable<Key>& table)
+                : table_(table) {
+            }
+
+            void Add(Key key, std::string_view name) {
+                if (key == Key::UNKNOWN) {
+                    // Неизвестные ключи редки, поэтому хватает линейного поиска
+                    if (std::find(unknown_.begin(), unknown_.end(), name) != unknown_.end()) {
+                        ThrowDuplicate(name);
+                    }
+                    unknown_.emplace_back(name);
+                    return;
+                }
+                const uint32_t bit = uint32_t{ 1 } << static_cast<size_t>(key);
+                if (mask_ & bit) {
+                    ThrowDuplicate(name);
+                }
+                mask_ |= bit;
+            }
+
+            bool Has(Key key) const {
+                return mask_ & (uint32_t{ 1 } << static_cast<size_t>(key));
+            }
+
+            void Require(Key key) const {
+                if (!Has(key)) {
+                    throw std::out_of_range("Key '"s + std::string(table_.Name(key)) + "' not found"s);
+                }
+            }
+
+            template <typename... Keys>
+            void Require(Key key, Keys... keys) const {
+                Require(key);
+                Require(keys...);
+            }
+
+        private:
+            [[noreturn]] static void ThrowDuplicate(std::string_view name) {
+                throw json::ParsingError("Duplicate key '"s + std::string(name) + "' have been found");
             }
+
+            const KeyTable<Key>& table_;
+            uint32_t mask_ = 0;
+            std::vector<std::string> unknown_;
+        };
+
+        enum class BaseRequestKey {
+            TYPE,
+            NAME,
+            LATITUDE,
+            LONGITUDE,
+            ROAD_DISTANCES,
+            STOPS,
+            IS_ROUNDTRIP,
+            UNKNOWN,
+        };
+
+        constexpr KeyTable<BaseRequestKey> BASE_REQUEST_KEYS(std::array{
+            "type"sv, "name"sv, "latitude"sv, "longitude"sv, "road_distances"sv, "stops"sv, "is_roundtrip"sv,
+        });
+
+        enum class StatRequestKey {
+            ID,
+            TYPE,
+            NAME,
+            FROM,
+            TO,
+            BBOX,
+            TILE,
+            UNKNOWN,
+        };
+
+        constexpr KeyTable<StatRequestKey> STAT_REQUEST_KEYS(std::array{
+            "id"sv, "type"sv, "name"sv, "from"sv, "to"sv, "bbox"sv, "tile"sv,
+        });
+
+        enum class RenderSettingsKey {
+            WIDTH,
+            HEIGHT,
+            PADDING,
+            LINE_WIDTH,
+            STOP_RADIUS,
+            BUS_LABEL_FONT_SIZE,
+            BUS_LABEL_OFFSET,
+            STOP_LABEL_FONT_SIZE,
+            STOP_LABEL_OFFSET,
+            UNDERLAYER_COLOR,
+            UNDERLAYER_WIDTH,
+            COLOR_PALETTE,
+            POLYLINE_TOLERANCE,
+            UNKNOWN,
+        };
+
+        constexpr KeyTable<RenderSettingsKey> RENDER_SETTINGS_KEYS(std::array{
+            "width"sv, "height"sv, "padding"sv, "line_width"sv, "stop_radius"sv,
+            "bus_label_font_size"sv, "bus_label_offset"sv, "stop_label_font_size"sv, "stop_label_offset"sv,
+            "underlayer_color"sv, "underlayer_width"sv, "color_palette"sv, "polyline_tolerance"sv,
+        });
+
+        enum class RoutingSettingsKey {
+            BUS_WAIT_TIME,
+            BUS_VELOCITY,
+            UNKNOWN,
+        };
+
+        constexpr KeyTable<RoutingSettingsKey> ROUTING_SETTINGS_KEYS(std::array{
+            "bus_wait_time"sv, "bus_velocity"sv,
+        });
+
+        RequestType ParseRequestType(std::string_view type) {
+            if (type == "Stop"sv) {
+                return RequestType::STOP;
+            }
+            if (type == "Bus"sv) {
+                return RequestType::BUS;
+            }
+            if (type == "Map"sv) {
+                return RequestType::MAP;
+            }
+            if (type == "Route"sv) {
+                return RequestType::ROUTE;
+            }
+            return RequestType::UNKNOWN;
         }
 
-        LoadDistances();
+        // Цвет бывает строкой или массивом, поэтому разбирается из узла
+        svg::Color ReadColor(const json::Node& color) {
+            if (color.IsString()) {
+                return std::string(color.AsString());
+            }
+            if (!color.IsArray()) {
+                throw std::logic_error("wrong color");
+            }
+            const json::Array& components = color.AsArray();
+            if (components.size() == 3) {
+                return svg::Rgb(components[0].AsInt(), components[1].AsInt(), components[2].AsInt());
+            }
+            if (components.size() == 4) {
+                return svg::Rgba(components[0].AsInt(), components[1].AsInt(), components[2].AsInt(), components[3].AsDouble());
+            }
+            throw std::logic_error("wrong color type");
+        }
+
+        svg::Point ReadPoint(const json::Node& point) {
+            const json::Array& coordinates = point.AsArray();
+            return { coordinates.at(0).AsDouble(), coordinates.at(1).AsDouble() };
+        }
+
+        renderer::GeoRect ReadGeoRect(const json::Node& rect) {
+            const json::Dict& bounds = rect.AsMap();
+            return { bounds.at("min_lat").AsDouble(), bounds.at("min_lng").AsDouble(),
+                bounds.at("max_lat").AsDouble(), bounds.at("max_lng").AsDouble() };
+        }
+
+        renderer::Tile ReadTile(const json::Node& tile) {
+            const json::Dict& position = tile.AsMap();
+            return { position.at("z").AsInt(), position.at("x").AsInt(), position.at("y").AsInt() };
+        }
 
-        for (auto& request_bus : arr) {
-            const auto& request_bus_map = request_bus.AsMap();
-            const auto& type = request_bus_map.at("type").AsString();
-            if (type == "Bus") {
-                LoadBus(request_bus_map);
+        // Декодеры записей читают значения прямо из входного буфера.
+        // Значения неизвестных ключей пропускаются без разбора в узлы
+
+        BaseRequest DecodeBaseRequest(json::Reader& reader) {
+            BaseRequest request;
+            SeenKeys seen(BASE_REQUEST_KEYS);
+            reader.StartDict();
+            for (std::string_view key; reader.NextKey(key);) {
+                const BaseRequestKey known_key = BASE_REQUEST_KEYS.Find(key);
+                seen.Add(known_key, key);
+                switch (known_key) {
+                case BaseRequestKey::TYPE:
+                    request.type = ParseRequestType(reader.ReadString());
+                    break;
+                case BaseRequestKey::NAME:
+                    request.name = reader.ReadString();
+                    break;
+                case BaseRequestKey::LATITUDE:
+                    request.coordinates.lat = reader.ReadDouble();
+                    break;
+                case BaseRequestKey::LONGITUDE:
+                    request.coordinates.lng = reader.ReadDouble();
+                    break;
+                case BaseRequestKey::ROAD_DISTANCES:
+                    reader.StartDict();
+                    for (std::string_view stop_name; reader.NextKey(stop_name);) {
+                        // Расстояний у остановки немного, поэтому повтор ищется линейно
+                        const auto same_stop = [stop_name](const auto& distance) {
+                            return distance.first == stop_name;
+                        };
+                        if (std::any_of(request.road_distances.begin(), request.road_distances.end(), same_stop)) {
+                            throw json::ParsingError("Duplicate key '"s + std::string(stop_name) + "' have been found");
+                        }
+                        std::string name(stop_name);
+                        request.road_distances.emplace_back(std::move(name), reader.ReadInt());
+                    }
+                    break;
+                case BaseRequestKey::STOPS:
+                    reader.StartArray();
+                    while (reader.NextItem()) {
+                        request.stops.emplace_back(reader.ReadString());
+                    }
+                    break;
+                case BaseRequestKey::IS_ROUNDTRIP:
+                    request.is_roundtrip = reader.ReadBool();
+                    break;
+                case BaseRequestKey::UNKNOWN:
+                    reader.SkipValue();
+                    break;
+                }
+            }
+            seen.Require(BaseRequestKey::TYPE, BaseRequestKey::NAME);
+            if (request.type == RequestType::STOP) {
+                seen.Require(BaseRequestKey::LATITUDE, BaseRequestKey::LONGITUDE, BaseRequestKey::ROAD_DISTANCES);
+            }
+            else if (request.type == RequestType::BUS) {
+                seen.Require(BaseRequestKey::STOPS, BaseRequestKey::IS_ROUNDTRIP);
             }
+            return request;
+        }
+
+        StatRequest DecodeStatRequest(json::Reader& reader) {
+            StatRequest request;
+            SeenKeys seen(STAT_REQUEST_KEYS);
+            reader.StartDict();
+            for (std::string_view key; reader.NextKey(key);) {
+                const StatRequestKey known_key = STAT_REQUEST_KEYS.Find(key);
+                seen.Add(known_key, key);
+                switch (known_key) {
+                case StatRequestKey::ID:
+                    request.id = reader.ReadInt();
+                    break;
+                case StatRequestKey::TYPE:
+                    request.type = ParseRequestType(reader.ReadString());
+                    break;
+                case StatRequestKey::NAME:
+                    request.name = reader.ReadString();
+                    break;
+                case StatRequestKey::FROM:
+                    request.from = reader.ReadString();
+                    break;
+                case StatRequestKey::TO:
+                    request.to = reader.ReadString();
+                    break;
+                case StatRequestKey::BBOX:
+                    request.area = ReadGeoRect(reader.ReadNode());
+                    break;
+                case StatRequestKey::TILE:
+                    // Как и при чтении из документа, bbox важнее tile
+                    if (!seen.Has(StatRequestKey::BBOX)) {
+                        request.area = ReadTile(reader.ReadNode());
+                    }
+                    else {
+                        reader.SkipValue();
+                    }
+                    break;
+                case StatRequestKey::UNKNOWN:
+                    reader.SkipValue();
+                    break;
+                }
+            }
+            seen.Require(StatRequestKey::ID, StatRequestKey::TYPE);
+            if (request.type == RequestType::STOP || request.type == RequestType::BUS) {
+                seen.Require(StatRequestKey::NAME);
+            }
+            else if (request.type == RequestType::ROUTE) {
+                seen.Require(StatRequestKey::FROM, StatRequestKey::TO);
+            }
+            return request;
+        }
+
+        renderer::RenderSettings DecodeRenderSettings(json::Reader& reader) {
+            renderer::RenderSettings settings;
+            SeenKeys seen(RENDER_SETTINGS_KEYS);
+            reader.StartDict();
+            for (std::string_view key; reader.NextKey(key);) {
+                const RenderSettingsKey known_key = RENDER_SETTINGS_KEYS.Find(key);
+                seen.Add(known_key, key);
+                switch (known_key) {
+                case RenderSettingsKey::WIDTH:
+                    settings.width = reader.ReadDouble();
+                    break;
+                case RenderSettingsKey::HEIGHT:
+                    settings.height = reader.ReadDouble();
+                    break;
+                case RenderSettingsKey::PADDING:
+                    settings.padding = reader.ReadDouble();
+                    break;
+                case RenderSettingsKey::LINE_WIDTH:
+                    settings.line_width = reader.ReadDouble();
+                    break;
+                case RenderSettingsKey::STOP_RADIUS:
+                    settings.stop_radius = reader.ReadDouble();
+                    break;
+                case RenderSettingsKey::BUS_LABEL_FONT_SIZE:
+                    settings.bus_label_font_size = reader.ReadInt();
+                    break;
+                case RenderSettingsKey::BUS_LABEL_OFFSET:
+                    settings.bus_label_offset = ReadPoint(reader.ReadNode());
+                    break;
+                case RenderSettingsKey::STOP_LABEL_FONT_SIZE:
+                    settings.stop_label_font_size = reader.ReadInt();
+                    break;
+                case RenderSettingsKey::STOP_LABEL_OFFSET:
+                    settings.stop_label_offset = ReadPoint(reader.ReadNode());
+                    break;
+                case RenderSettingsKey::UNDERLAYER_COLOR:
+                    settings.underlayer_color = ReadColor(reader.ReadNode());
+                    break;
+                case RenderSettingsKey::UNDERLAYER_WIDTH:
+                    settings.underlayer_width = reader.ReadDouble();
+                    break;
+                case RenderSettingsKey::COLOR_PALETTE:
+                    reader.StartArray();
+                    while (reader.NextItem()) {
+                        settings.color_palette.push_back(ReadColor(reader.ReadNode()));
+                    }
+                    break;
+                case RenderSettingsKey::POLYLINE_TOLERANCE:
+                    settings.polyline_tolerance = reader.ReadDouble();
+                    break;
+                case RenderSettingsKey::UNKNOWN:
+                    reader.SkipValue();
+                    break;
+                }
+            }
+            // В порядке чтения из документа, чтобы ошибка называла тот же ключ
+            seen.Require(RenderSettingsKey::WIDTH, RenderSettingsKey::HEIGHT, RenderSettingsKey::PADDING,
+                RenderSettingsKey::STOP_RADIUS, RenderSettingsKey::LINE_WIDTH, RenderSettingsKey::BUS_LABEL_FONT_SIZE,
+                RenderSettingsKey::BUS_LABEL_OFFSET, RenderSettingsKey::STOP_LABEL_FONT_SIZE, RenderSettingsKey::STOP_LABEL_OFFSET,
+                RenderSettingsKey::UNDERLAYER_COLOR, RenderSettingsKey::UNDERLAYER_WIDTH, RenderSettingsKey::COLOR_PALETTE);
+            return settings;
+        }
+
+        RoutingSettings DecodeRoutingSettings(json::Reader& reader) {
+            RoutingSettings settings;
+            SeenKeys seen(ROUTING_SETTINGS_KEYS);
+            reader.StartDict();
+            for (std::string_view key; reader.NextKey(key);) {
+                const RoutingSettingsKey known_key = ROUTING_SETTINGS_KEYS.Find(key);
+                seen.Add(known_key, key);
+                switch (known_key) {
+                case RoutingSettingsKey::BUS_WAIT_TIME:
+                    settings.bus_wait_time = reader.ReadInt();
+                    break;
+                case RoutingSettingsKey::BUS_VELOCITY:
+                    settings.bus_velocity = reader.ReadDouble();
+                    break;
+                case RoutingSettingsKey::UNKNOWN:
+                    reader.SkipValue();
+                    break;
+                }
+            }
+            seen.Require(RoutingSettingsKey::BUS_WAIT_TIME, RoutingSettingsKey::BUS_VELOCITY);
+            return settings;
+        }
+
+        // Те же записи из готового документа (режимы DOCUMENT и PARALLEL)
+
+        BaseRequest ReadBaseRequest(const json::Dict& request_map) {
+            BaseRequest request;
+            request.type = ParseRequestType(request_map.at("type").AsString());
+            request.name = request_map.at("name").AsString();
+            if (request.type == RequestType::STOP) {
+                request.coordinates = { request_map.at("latitude").AsDouble(), request_map.at("longitude").AsDouble() };
+                for (const auto& [stop_name, distance] : request_map.at("road_distances").AsMap()) {
+                    request.road_distances.emplace_back(std::string(stop_name), distance.AsInt());
+                }
+            }
+            else if (request.type == RequestType::BUS) {
+                for (const auto& stop : request_map.at("stops").AsArray()) {
+                    request.stops.emplace_back(stop.AsString());
+                }
+                request.is_roundtrip = request_map.at("is_roundtrip").AsBool();
+            }
+            return request;
+        }
+
+        StatRequest ReadStatRequest(const json::Dict& request_map) {
+            StatRequest request;
+            request.id = request_map.at("id").AsInt();
+            request.type = ParseRequestType(request_map.at("type").AsString());
+            if (request.type == RequestType::STOP || request.type == RequestType::BUS) {
+                request.name = request_map.at("name").AsString();
+            }
+            else if (request.type == RequestType::ROUTE) {
+                request.from = request_map.at("from").AsString();
+                request.to = request_map.at("to").AsString();
+            }
+            else if (request.type == RequestType::MAP) {
+                if (const auto bbox = request_map.find("bbox"); bbox != request_map.end()) {
+                    request.area = ReadGeoRect(bbox->second);
+                }
+                else if (const auto tile = request_map.find("tile"); tile != request_map.end()) {
+                    request.area = ReadTile(tile->second);
+                }
+            }
+            return request;
+        }
+
+        renderer::RenderSettings ReadRenderSettings(const json::Dict& request_map) {
+            renderer::RenderSettings settings;
+            settings.width = request_map.at("width").AsDouble();
+            settings.height = request_map.at("height").AsDouble();
+            settings.padding = request_map.at("padding").AsDouble();
+            settings.stop_radius = request_map.at("stop_radius").AsDouble();
+            settings.line_width = request_map.at("line_width").AsDouble();
+            settings.bus_label_font_size = request_map.at("bus_label_font_size").AsInt();
+            settings.bus_label_offset = ReadPoint(request_map.at("bus_label_offset"));
+            settings.stop_label_font_size = request_map.at("stop_label_font_size").AsInt();
+            settings.stop_label_offset = ReadPoint(request_map.at("stop_label_offset"));
+            settings.underlayer_color = ReadColor(request_map.at("underlayer_color"));
+            settings.underlayer_width = request_map.at("underlayer_width").AsDouble();
+            for (const auto& color : request_map.at("color_palette").AsArray()) {
+                settings.color_palette.push_back(ReadColor(color));
+            }
+            if (const auto tolerance = request_map.find("polyline_tolerance"); tolerance != request_map.end()) {
+                settings.polyline_tolerance = tolerance->second.AsDouble();
+            }
+            return settings;
+        }
+
+        RoutingSettings ReadRoutingSettings(const json::Dict& request_map) {
+            return { request_map.at("bus_wait_time").AsInt(), request_map.at("bus_velocity").AsDouble() };
+        }
+    }  // namespace
+
+    std::string_view RequestTypeName(RequestType type) {
+        switch (type) {
+        case RequestType::STOP:
+            return "Stop"sv;
+        case RequestType::BUS:
+            return "Bus"sv;
+        case RequestType::MAP:
+            return "Map"sv;
+        case RequestType::ROUTE:
+            return "Route"sv;
+        default:
+            return "Unknown"sv;
         }
     }
 
-    const json::Node& JsonReader::GetBaseRequests() const
-    {
-        if (!document_.GetRoot().AsMap().count("base_requests"))
-        {
-            static json::Node nullNode(nullptr);
-            return nullNode;
+    std::vector<StatRequest> ReadStatRequests(const json::Node& requests) {
+        std::vector<StatRequest> result;
+        if (requests.IsMap()) {
+            result.push_back(ReadStatRequest(requests.AsMap()));
+            return result;
+        }
+        result.reserve(requests.AsArray().size());
+        for (const auto& request : requests.AsArray()) {
+            result.push_back(ReadStatRequest(request.AsMap()));
         }
-        return document_.GetRoot().AsMap().at("base_requests");
+        return result;
     }
 
-    const json::Node& JsonReader::GetStatRequests() const
-    {
-        if (!document_.GetRoot().AsMap().count("stat_requests"))
-        {
-            static json::Node nullNode(nullptr);
-            return nullNode;
+    JsonReader::JsonReader(transport_catalogue::TransportCatalogue& tc, std::istream& input, LoadMode mode)
+        : transport_catalogue_(tc)
+        , mode_(mode) {
+        switch (mode_) {
+        case LoadMode::STREAMING:
+            LoadStreaming(input);
+            break;
+        case LoadMode::PARALLEL:
+            LoadDocument(json::LoadParallel(input));
+            break;
+        default:
+            LoadDocument(json::Load(input));
+            break;
         }
-        return document_.GetRoot().AsMap().at("stat_requests");
     }
 
-    const json::Node& JsonReader::GetRenderSettings() const {
-        if (!document_.GetRoot().AsMap().count("render_settings")) {
-            static json::Node nullNode(nullptr);
-            return nullNode;
+    void JsonReader::LoadDocument(const json::Document& document) {
+        const auto& root = document.GetRoot().AsMap();
+        if (const auto it = root.find("base_requests"); it != root.end()) {
+            for (const auto& request : it->second.AsArray()) {
+                base_requests_.push_back(ReadBaseRequest(request.AsMap()));
+            }
+        }
+        if (const auto it = root.find("stat_requests"); it != root.end()) {
+            for (const auto& request : it->second.AsArray()) {
+                stat_requests_.push_back(ReadStatRequest(request.AsMap()));
+            }
+        }
+        if (const auto it = root.find("render_settings"); it != root.end()) {
+            render_settings_ = ReadRenderSettings(it->second.AsMap());
+        }
+        if (const auto it = root.find("routing_settings"); it != root.end()) {
+            routing_settings_ = ReadRoutingSettings(it->second.AsMap());
         }
-        return document_.GetRoot().AsMap().at("render_settings");
     }
 
-    const json::Node& JsonReader::GetRoutingSettings() const {
-        if (!document_.GetRoot().AsMap().count("routing_settings")) {
-            static json::Node nullNode(nullptr);
-            return nullNode;
+    void JsonReader::LoadDataToCatalogue() {
+        TRACE_SCOPE("JsonReader::LoadDataToCatalogue");
+        if (mode_ == LoadMode::STREAMING) {
+            // base_requests уже загружены при разборе входных данных
+            return;
         }
-        return document_.GetRoot().AsMap().at("routing_settings");
+
+        for (const auto& request : base_requests_) {
+            if (request.type == RequestType::STOP) {
+                LoadStop(request);
+            }
+        }
+
+        LoadDistances();
+
+        for (const auto& request : base_requests_) {
+            if (request.type == RequestType::BUS) {
+                LoadBus(request);
+            }
+        }
+
+        base_requests_.clear();
+        base_requests_.shrink_to_fit();
+    }
+
+    const std::vector<StatRequest>& JsonReader::GetStatRequests() const {
+        return stat_requests_;
     }
 
-    void JsonReader::LoadStop(const json::Dict& request_map)
+    void JsonReader::LoadStop(const BaseRequest& request)
     {
-        std::string_view stop_name = request_map.at("name").AsString();
-        geo::Coordinates coordinates = { request_map.at("latitude").AsDouble(), request_map.at("longitude").AsDouble() };
-        transport_catalogue_.AddStop((std::string)stop_name, coordinates);
+        transport_catalogue_.AddStop(request.name, request.coordinates);
     }
 
-    void JsonReader::LoadBus(const json::Dict& request_map)
+    void JsonReader::LoadBus(const BaseRequest& request)
     {
-        std::string_view bus_number = request_map.at("name").AsString();
         std::vector<std::string_view> stops;
-        for (auto& stop : request_map.at("stops").AsArray()) {
-            stops.push_back(transport_catalogue_.FindStop(stop.AsString())->name);
+        stops.reserve(request.stops.size());
+        for (const auto& stop : request.stops) {
+            stops.push_back(transport_catalogue_.FindStop(stop)->name);
         }
-        bool is_circle = request_map.at("is_roundtrip").AsBool();
-
-        transport_catalogue_.AddBus((std::string)bus_number, stops, is_circle);
+        transport_catalogue_.AddBus(request.name, stops, request.is_roundtrip);
     }
 
     void JsonReader::LoadDistances()
     {
-        const json::Array& arr = GetBaseRequests().AsArray();
-        for (auto& request_stops : arr) {
-            const auto& request_stops_map = request_stops.AsMap();
-            const auto& type = request_stops_map.at("type").AsString();
-            if (type == "Stop") {
-                std::string_view stop_name = request_stops_map.at("name").AsString();
-                auto stop_temp = transport_catalogue_.FindStop(stop_name);
-                auto& distances = request_stops_map.at("road_distances").AsMap();
-                std::map<std::string_view, int> stop_distances;
-                for (auto& [stop_name, dist] : distances) {
-                    stop_distances.emplace(stop_name, dist.AsInt());
-                }
-                for (auto& [to_name, dist] : stop_distances) {
+        for (const auto& request : base_requests_) {
+            if (request.type == RequestType::STOP) {
+                auto stop_temp = transport_catalogue_.FindStop(request.name);
+                for (const auto& [to_name, dist] : request.road_distances) {
                     auto to = transport_catalogue_.FindStop(to_name);
                     transport_catalogue_.AddStopDistance(stop_temp->name, to->name, dist);
                 }
@@ -104,73 +636,76 @@ namespace json_reader {
         }
     }
 
+    renderer::MapRenderer JsonReader::LoadRenderSettings() const {
+        TRACE_SCOPE("JsonReader::LoadRenderSettings");
+        return render_settings_;
+    }
 
-    renderer::MapRenderer JsonReader::LoadRenderSettings(const json::Node& request) const {
-        /*struct RenderSettings {
-        double width = 0.0;
-        double height = 0.0;
-        double padding = 0.0;
-        double line_width = 0.0;
-        double stop_radius = 0.0;
-        int bus_label_font_size = 0;
-        svg::Point bus_label_offset = { 0.0, 0.0 };
-        int stop_label_font_size = 0;
-        svg::Point stop_label_offset = { 0.0, 0.0 };
-        svg::Color underlayer_color = { svg::NoneColor };
-        double underlayer_width = 0.0;
-        std::vector<svg::Color> color_palette {};
-        */
-        json::Dict request_map = request.AsMap();
-
-        renderer::RenderSettings render_settings;
-        render_settings.width = request_map.at("width").AsDouble();
-        render_settings.height = request_map.at("height").AsDouble();
-        render_settings.padding = request_map.at("padding").AsDouble();
-        render_settings.stop_radius = request_map.at("stop_radius").AsDouble();
-        render_settings.line_width = request_map.at("line_width").AsDouble();
-        render_settings.bus_label_font_size = request_map.at("bus_label_font_size").AsInt();
-        const json::Array& bus_label_offset = request_map.at("bus_label_offset").AsArray();
-        render_settings.bus_label_offset = { bus_label_offset[0].AsDouble(), bus_label_offset[1].AsDouble() };
-        render_settings.stop_label_font_size = request_map.at("stop_label_font_size").AsInt();
-        const json::Array& stop_label_offset = request_map.at("stop_label_offset").AsArray();
-        render_settings.stop_label_offset = { stop_label_offset[0].AsDouble(), stop_label_offset[1].AsDouble() };
-
-        if (request_map.at("underlayer_color").IsString()) render_settings.underlayer_color = request_map.at("underlayer_color").AsString();
-        else if (request_map.at("underlayer_color").IsArray()) {
-            const json::Array& underlayer_color = request_map.at("underlayer_color").AsArray();
-            if (underlayer_color.size() == 3) {
-                render_settings.underlayer_color = svg::Rgb(underlayer_color[0].AsInt(), underlayer_color[1].AsInt(), underlayer_color[2].AsInt());
-            }
-            else if (underlayer_color.size() == 4) {
-                render_settings.underlayer_color = svg::Rgba(underlayer_color[0].AsInt(), underlayer_color[1].AsInt(), underlayer_color[2].AsInt(), underlayer_color[3].AsDouble());
-            }
-            else throw std::logic_error("wrong underlayer colortype");
-        }
-        else throw std::logic_error("wrong underlayer color");
-
-        render_settings.underlayer_width = request_map.at("underlayer_width").AsDouble();
-
-        const json::Array& color_palette = request_map.at("color_palette").AsArray();
-        for (const auto& color_element : color_palette) {
-            if (color_element.IsString()) render_settings.color_palette.emplace_back(color_element.AsString());
-            else if (color_element.IsArray()) {
-                const json::Array& color_type = color_element.AsArray();
-                if (color_type.size() == 3) {
-                    render_settings.color_palette.emplace_back(svg::Rgb(color_type[0].AsInt(), color_type[1].AsInt(), color_type[2].AsInt()));
-                }
-                else if (color_type.size() == 4) {
-                    render_settings.color_palette.emplace_back(svg::Rgba(color_type[0].AsInt(), color_type[1].AsInt(), color_type[2].AsInt(), color_type[3].AsDouble()));
-                }
-                else throw std::logic_error("wrong color_palette type");
-            }
-            else throw std::logic_error("wrong color_palette");
-        }
-
-        return render_settings;
+    transport_catalogue::Router JsonReader::LoadRoutingSettings() const {
+        return transport_catalogue::Router{ routing_settings_.bus_wait_time, routing_settings_.bus_velocity };
     }
 
+    void JsonReader::LoadStreaming(std::istream& input) {
+        json::StreamHandlers handlers;
+        handlers.emplace("base_requests", [this](json::Reader& reader) {
+            reader.StartArray();
+            while (reader.NextItem()) {
+                LoadBaseRequest(DecodeBaseRequest(reader));
+            }
+            });
+        handlers.emplace("stat_requests", [this](json::Reader& reader) {
+            reader.StartArray();
+            while (reader.NextItem()) {
+                stat_requests_.push_back(DecodeStatRequest(reader));
+            }
+            });
+        handlers.emplace("render_settings", [this](json::Reader& reader) {
+            render_settings_ = DecodeRenderSettings(reader);
+            });
+        handlers.emplace("routing_settings", [this](json::Reader& reader) {
+            routing_settings_ = DecodeRoutingSettings(reader);
+            });
+        json::Load(input, handlers);
+        LoadPendingRequests();
+    }
 
-    transport_catalogue::Router JsonReader::LoadRoutingSettings(const json::Node& routing_settings) const {
-        return transport_catalogue::Router{ routing_settings.AsMap().at("bus_wait_time").AsInt(), routing_settings.AsMap().at("bus_velocity").AsDouble() };
+    void JsonReader::LoadBaseRequest(BaseRequest&& request) {
+        if (request.type == RequestType::STOP) {
+            LoadStop(request);
+            const auto stop = transport_catalogue_.FindStop(request.name);
+            for (auto& [to_name, dist] : request.road_distances) {
+                if (const auto to = transport_catalogue_.FindStop(to_name)) {
+                    transport_catalogue_.AddStopDistance(stop->name, to->name, dist);
+                }
+                else {
+                    pending_distances_.push_back({ stop->name, std::move(to_name), dist });
+                }
+            }
+        }
+        else if (request.type == RequestType::BUS) {
+            const bool stops_known = std::all_of(request.stops.begin(), request.stops.end(), [this](const std::string& stop) {
+                return transport_catalogue_.FindStop(stop) != nullptr;
+                });
+            // Маршруты добавляются в порядке документа, от него зависят их номера Bus::id
+            if (stops_known && pending_buses_.empty()) {
+                LoadBus(request);
+            }
+            else {
+                pending_buses_.push_back(std::move(request));
+            }
+        }
+    }
+
+    void JsonReader::LoadPendingRequests() {
+        for (const auto& [from, to, distance] : pending_distances_) {
+            transport_catalogue_.AddStopDistance(from, to, distance);
+        }
+        for (const auto& request : pending_buses_) {
+            LoadBus(request);
+        }
+        pending_distances_.clear();
+        pending_distances_.shrink_to_fit();
+        pending_buses_.clear();
+        pending_buses_.shrink_to_fit();
     }
-}
\ No newline at end of file
+}
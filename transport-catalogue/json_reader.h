@@ -1,6 +1,10 @@
 #pragma once
 
 #include <iostream>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
 #include "transport_catalogue.h"
 #include "json.h"
 #include "map_renderer.h"
@@ -9,27 +13,91 @@
 
 namespace json_reader {
 
+    enum class LoadMode {
+        DOCUMENT,   // входные данные целиком разбираются в документ, затем переводятся в записи
+        STREAMING,  // записи декодируются прямо из входного буфера, документ не строится
+        PARALLEL,   // как DOCUMENT, но массивы корневого словаря разбираются на нескольких потоках
+    };
+
+    enum class RequestType {
+        UNKNOWN,
+        STOP,
+        BUS,
+        MAP,
+        ROUTE,
+    };
+
+    std::string_view RequestTypeName(RequestType type);
+
+    // Запись из base_requests: остановка (STOP) или маршрут (BUS)
+    struct BaseRequest {
+        RequestType type = RequestType::UNKNOWN;
+        std::string name;
+        geo::Coordinates coordinates = { 0.0, 0.0 };
+        std::vector<std::pair<std::string, int>> road_distances;
+        std::vector<std::string> stops;
+        bool is_roundtrip = false;
+    };
+
+    // Запрос из stat_requests. name заполняется у запросов Stop и Bus, from и to - у Route.
+    // Запрос Map с ключом "bbox" ({"min_lat", "min_lng", "max_lat", "max_lng"}) или
+    // "tile" ({"z", "x", "y"}) запрашивает только эту часть карты
+    struct StatRequest {
+        int id = 0;
+        RequestType type = RequestType::UNKNOWN;
+        std::string name;
+        std::string from;
+        std::string to;
+        renderer::MapArea area;
+    };
+
+    struct RoutingSettings {
+        int bus_wait_time = 0;
+        double bus_velocity = 0.0;
+    };
+
+    // Запросы к базе из отдельного документа (например, присланного серверу):
+    // массива запросов или одного запроса
+    std::vector<StatRequest> ReadStatRequests(const json::Node& requests);
+
     class JsonReader {
     public:
-        JsonReader(transport_catalogue::TransportCatalogue& tc, std::istream& input) : transport_catalogue_(tc), document_(json::Load(input)) {}
+        JsonReader(transport_catalogue::TransportCatalogue& tc, std::istream& input, LoadMode mode = LoadMode::DOCUMENT);
 
         void LoadDataToCatalogue();
-        const json::Node& GetBaseRequests() const;
-        const json::Node& GetStatRequests() const;
-        const json::Node& GetRenderSettings() const;
-        const json::Node& GetRoutingSettings() const;
-        renderer::MapRenderer LoadRenderSettings(const json::Node& request_map) const;
-        transport_catalogue::Router LoadRoutingSettings(const json::Node& routing_settings) const;
+        const std::vector<StatRequest>& GetStatRequests() const;
+        renderer::MapRenderer LoadRenderSettings() const;
+        transport_catalogue::Router LoadRoutingSettings() const;
 
     private:
-        void LoadStop(const json::Dict& request_map);
-        void LoadBus(const json::Dict& request_map);
+        void LoadStop(const BaseRequest& request);
+        void LoadBus(const BaseRequest& request);
         void LoadDistances();
 
+        // Переводит разобранный документ в записи, сам документ после этого не нужен
+        void LoadDocument(const json::Document& document);
+
+        // Потоковая загрузка: остановки и расстояния добавляются сразу,
+        // записи со ссылками на ещё не известные остановки откладываются до конца массива
+        void LoadStreaming(std::istream& input);
+        void LoadBaseRequest(BaseRequest&& request);
+        void LoadPendingRequests();
+
+        struct PendingDistance {
+            std::string from;
+            std::string to;
+            int distance = 0;
+        };
 
     private:
         transport_catalogue::TransportCatalogue& transport_catalogue_;
-        json::Document document_;
+        LoadMode mode_;
+        std::vector<BaseRequest> base_requests_;
+        std::vector<PendingDistance> pending_distances_;
+        std::vector<BaseRequest> pending_buses_;
+        std::vector<StatRequest> stat_requests_;
+        renderer::RenderSettings render_settings_;
+        RoutingSettings routing_settings_;
     };
 
 }  // namespace json_reader
\ No newline at end of file
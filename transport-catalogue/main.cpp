@@ -1,10 +1,24 @@
+#include "city_generator.h"
 #include "json_reader.h"
 #include "request_handler.h"
 #include "transport_catalogue.h"
 #include "map_renderer.h"
+#include "server.h"
+#include "tracing.h"
+#include <algorithm>
+#include <charconv>
+#include <fstream>
 #include <iostream>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
 
-int main() {
+using namespace std::literals;
+
+int main(int argc, char* argv[]) {
     /*
      * Примерная структура программы:
      *
@@ -12,20 +26,219 @@ int main() {
      * Построить на его основе JSON базу данных транспортного справочника
      * Выполнить запросы к справочнику, находящиеся в массива "stat_requests", построив JSON-массив
      * с ответами Вывести в stdout ответы в виде JSON
+     *
+     * Ключи командной строки:
+     *   --parallel-parse  разобрать массивы входного документа на нескольких потоках
+     *                     (по умолчанию base_requests загружаются в справочник потоково)
+     *   --threads N       обрабатывать stat_requests на N потоках (0 - по числу ядер),
+     *                     ответы выводятся в исходном порядке. По умолчанию 1
+     *   --stats           вывести в stderr число и время обработки запросов каждого типа
+     *   --stats-file PATH то же, но в файл PATH
+     *   --trace PATH      записать интервалы фаз работы в PATH в формате Chrome trace event
+     *                     (только при сборке с TRANSPORT_CATALOGUE_TRACING)
+     *   --trace-requests  вместе с --trace записывать и интервалы отдельных запросов
+     *   --generate PARAMS вместо обработки stdin вывести синтетический входной документ,
+     *                     например --generate stops=1000,buses=100,route_requests=5000
+     *                     (параметры описаны в city_generator.h)
+     *   --serve PATH      после ответа на stat_requests из stdin не завершаться, а принимать
+     *                     запросы к загруженному справочнику через Unix domain socket PATH
+     *   --max-document-size BYTES
+     *                     предельный размер JSON-документа в режиме --serve, по умолчанию 16 МиБ
+     *   --capture PATH    записать обработанные запросы с моментами их поступления в PATH
+     *   --replay PATH     после загрузки справочника повторить запросы, записанные --capture,
+     *                     и вывести в stderr задержки относительно исходного расписания.
+     *                     Повторённые запросы не попадают в --stats и --capture
+     *   --replay-speed S  темп повтора: 1 - как при записи, 2 - вдвое быстрее,
+     *                     0 - без пауз (по умолчанию)
+     *   --protocol binary ответы на stat_requests выводятся, а запросы в режиме --serve
+     *                     принимаются в двоичном формате (описан в binary_protocol.h).
+     *                     По умолчанию --protocol json
      */
+    auto load_mode = json_reader::LoadMode::STREAMING;
+    size_t thread_count = 1;
+    std::string socket_path;
+    size_t max_document_size = server::Server::DEFAULT_MAX_DOCUMENT_SIZE;
+    bool print_stats = false;
+    std::string stats_path;
+    std::string trace_path;
+    bool trace_requests = false;
+    std::string capture_path;
+    std::string replay_path;
+    double replay_speed = 0.0;
+    auto protocol = request_handler::Protocol::JSON;
+    for (int i = 1; i < argc; ++i) {
+        const std::string_view arg = argv[i];
+        if (arg == "--parallel-parse"sv) {
+            load_mode = json_reader::LoadMode::PARALLEL;
+        }
+        else if (arg == "--threads"sv && i + 1 < argc) {
+            const std::string_view value = argv[++i];
+            const auto [ptr, ec] = std::from_chars(value.data(), value.data() + value.size(), thread_count);
+            if (ec != std::errc{} || ptr != value.data() + value.size()) {
+                std::cerr << "Invalid thread count: "sv << value << std::endl;
+                return 1;
+            }
+            if (thread_count == 0) {
+                thread_count = std::max(1u, std::thread::hardware_concurrency());
+            }
+        }
+        else if (arg == "--stats"sv) {
+            print_stats = true;
+        }
+        else if (arg == "--stats-file"sv && i + 1 < argc) {
+            print_stats = true;
+            stats_path = argv[++i];
+        }
+        else if (arg == "--trace"sv && i + 1 < argc) {
+            trace_path = argv[++i];
+        }
+        else if (arg == "--trace-requests"sv) {
+            trace_requests = true;
+        }
+        else if (arg == "--generate"sv && i + 1 < argc) {
+            try {
+                city_generator::GenerateCity(city_generator::ParseCityParams(argv[++i]), std::cout);
+            }
+            catch (const std::invalid_argument& e) {
+                std::cerr << e.what() << std::endl;
+                return 1;
+            }
+            return 0;
+        }
+        else if (arg == "--serve"sv && i + 1 < argc) {
+            socket_path = argv[++i];
+        }
+        else if (arg == "--max-document-size"sv && i + 1 < argc) {
+            const std::string_view value = argv[++i];
+            const auto [ptr, ec] = std::from_chars(value.data(), value.data() + value.size(), max_document_size);
+            if (ec != std::errc{} || ptr != value.data() + value.size() || max_document_size == 0) {
+                std::cerr << "Invalid document size: "sv << value << std::endl;
+                return 1;
+            }
+        }
+        else if (arg == "--protocol"sv && i + 1 < argc) {
+            const std::string_view value = argv[++i];
+            if (value == "json"sv) {
+                protocol = request_handler::Protocol::JSON;
+            }
+            else if (value == "binary"sv) {
+                protocol = request_handler::Protocol::BINARY;
+            }
+            else {
+                std::cerr << "Unknown protocol: "sv << value << std::endl;
+                return 1;
+            }
+        }
+        else if (arg == "--capture"sv && i + 1 < argc) {
+            capture_path = argv[++i];
+        }
+        else if (arg == "--replay"sv && i + 1 < argc) {
+            replay_path = argv[++i];
+        }
+        else if (arg == "--replay-speed"sv && i + 1 < argc) {
+            const std::string_view value = argv[++i];
+            const auto [ptr, ec] = std::from_chars(value.data(), value.data() + value.size(), replay_speed);
+            if (ec != std::errc{} || ptr != value.data() + value.size()) {
+                std::cerr << "Invalid replay speed: "sv << value << std::endl;
+                return 1;
+            }
+        }
+        else {
+            std::cerr << "Unknown option: "sv << arg << std::endl;
+            return 1;
+        }
+    }
+
+    if (!trace_path.empty()) {
+#ifdef TRANSPORT_CATALOGUE_TRACING
+        tracing::Start(trace_requests);
+#else
+        static_cast<void>(trace_requests);
+        std::cerr << "Tracing is not available: rebuild with TRANSPORT_CATALOGUE_TRACING defined"sv << std::endl;
+        return 1;
+#endif
+    }
+
+    // Запись читается до загрузки справочника, чтобы неверный файл не обнаружился в самом конце
+    std::vector<request_handler::CapturedRequest> replay_requests;
+    if (!replay_path.empty()) {
+        std::ifstream replay_file(replay_path, std::ios::binary);
+        try {
+            replay_requests = request_handler::ReadCapture(replay_file);
+        }
+        catch (const std::runtime_error& e) {
+            std::cerr << replay_path << ": "sv << e.what() << std::endl;
+            return 1;
+        }
+    }
+
+    std::ofstream capture_file;
+    std::optional<request_handler::RequestCapture> capture;
+    if (!capture_path.empty()) {
+        capture_file.open(capture_path, std::ios::binary);
+        if (!capture_file) {
+            std::cerr << "Cannot open "sv << capture_path << std::endl;
+            return 1;
+        }
+        capture.emplace(capture_file);
+    }
+
     transport_catalogue::TransportCatalogue catalogue;
-    json_reader::JsonReader reader(catalogue, std::cin);
+    json_reader::JsonReader reader(catalogue, std::cin, load_mode);
 
     reader.LoadDataToCatalogue();
 
 
-    const auto& render_settings = reader.GetRenderSettings();
-    const auto& renderer = reader.LoadRenderSettings(render_settings);
-
-    const auto& routing_settings = reader.GetRoutingSettings();
-    const auto& router_settings = reader.LoadRoutingSettings(routing_settings);
+    const auto& renderer = reader.LoadRenderSettings();
+    const auto& router_settings = reader.LoadRoutingSettings();
     const transport_catalogue::Router router = { router_settings, catalogue };
 
-    request_handler::RequestHandler request_handler(catalogue, renderer, reader, router);
+    request_handler::RequestStats stats;
+    request_handler::HandlerOptions options;
+    options.thread_count = thread_count;
+    options.stats = print_stats ? &stats : nullptr;
+    options.capture = capture ? &*capture : nullptr;
+    options.protocol = protocol;
+    request_handler::RequestHandler request_handler(catalogue, renderer, reader, router, options);
+
+    // Ошибка сервера не отменяет вывод --stats и --trace, но программа завершается с кодом 1
+    int exit_code = 0;
+    if (!socket_path.empty()) {
+        std::cout.flush();
+        try {
+            server::Server server(request_handler, socket_path, max_document_size);
+            server.Run();
+        }
+        catch (const std::exception& e) {
+            std::cerr << socket_path << ": "sv << e.what() << std::endl;
+            exit_code = 1;
+        }
+    }
+
+    if (!replay_path.empty() && exit_code == 0) {
+        std::cout.flush();
+        request_handler::RequestStats replay_stats;
+        request_handler::ReplayCapture(request_handler, replay_requests, replay_speed, replay_stats);
+        std::cerr << "replay of "sv << replay_path << ":\n"sv;
+        replay_stats.Print(std::cerr);
+    }
+
+    if (print_stats) {
+        if (stats_path.empty()) {
+            stats.Print(std::cerr);
+        }
+        else {
+            std::ofstream stats_file(stats_path);
+            stats.Print(stats_file);
+        }
+    }
+
+#ifdef TRANSPORT_CATALOGUE_TRACING
+    if (!trace_path.empty()) {
+        std::ofstream trace_file(trace_path);
+        tracing::Write(trace_file);
+    }
+#endif
 
-}
\ No newline at end of file
+    return exit_code;
+}
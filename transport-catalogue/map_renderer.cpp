@@ -1,5 +1,14 @@
 #include "map_renderer.h"
 
+#include <array>
+#include <atomic>
+#include <exception>
+#include <functional>
+#include <sstream>
+#include <thread>
+#include <cmath>
+#include <utility>
+
 /*
  * В этом файле вы можете разместить код, отвечающий за визуализацию карты маршрутов в формате SVG.
  * Визуализация маршртутов вам понадобится во второй части итогового проекта.
@@ -11,192 +20,724 @@ namespace renderer {
         return std::abs(value) < EPSILON;
     }
 
-    std::vector<svg::Polyline> MapRenderer::GetBusPolylines(const std::map<std::string_view, const transport_catalogue::Bus*>& buses, const SphereProjector& sphereProjector) const {
-        std::vector<svg::Polyline> result;
-        size_t colorNumber = 0;
-        for (const auto& bus : buses) {
-            if (bus.second->stops.empty())
-            {
-                continue;
-            }
+    svg::Polyline MapRenderer::MakeBusLine() const {
+        svg::Polyline line;
+        line.SetFillColor("none");
+        line.SetStrokeWidth(render_settings_.line_width);
+        line.SetStrokeLineCap(svg::StrokeLineCap::ROUND);
+        line.SetStrokeLineJoin(svg::StrokeLineJoin::ROUND);
+        return line;
+    }
 
-            std::vector<const transport_catalogue::Stop*> bus_stops = bus.second->stops;
-            if (!bus.second->is_circle)
-            {
-                bus_stops.insert(bus_stops.end(), std::next(bus.second->stops.rbegin()), bus.second->stops.rend());
-            }
+    std::pair<svg::Text, svg::Text> MapRenderer::MakeBusLabel() const {
+        svg::Text underlayerText;
+        underlayerText.SetFontFamily("Verdana");
+        underlayerText.SetFontSize(render_settings_.bus_label_font_size);
+        underlayerText.SetFontWeight("bold");
+        underlayerText.SetOffset(render_settings_.bus_label_offset);
+        underlayerText.SetFillColor(render_settings_.underlayer_color);
+        underlayerText.SetStrokeColor(render_settings_.underlayer_color);
+        underlayerText.SetStrokeWidth(render_settings_.underlayer_width);
+        underlayerText.SetStrokeLineCap(svg::StrokeLineCap::ROUND);
+        underlayerText.SetStrokeLineJoin(svg::StrokeLineJoin::ROUND);
+
+        svg::Text nameText;
+        nameText.SetOffset(render_settings_.bus_label_offset);
+        nameText.SetFontFamily("Verdana");
+        nameText.SetFontSize(render_settings_.bus_label_font_size);
+        nameText.SetFontWeight("bold");
+        return { std::move(underlayerText), std::move(nameText) };
+    }
 
-            svg::Polyline line;
-            for (const auto& stop : bus_stops) {
-                line.AddPoint(sphereProjector(stop->coods));
+    // Цвета палитры назначаются по кругу маршрутам с остановками в порядке названий.
+    // При пустой палитре (например, без render_settings) линии и надписи рисуются без цвета
+    const svg::Color& MapRenderer::GetBusColor(size_t bus_number) const {
+        if (render_settings_.color_palette.empty()) {
+            return svg::NoneColor;
+        }
+        return render_settings_.color_palette[GetColorIndex(bus_number)];
+    }
+
+    size_t MapRenderer::GetColorIndex(size_t bus_number) const {
+        const size_t palette_size = render_settings_.color_palette.size();
+        return palette_size == 0 ? 0 : bus_number % palette_size;
+    }
+
+    namespace {
+        double SquaredDistance(svg::Point lhs, svg::Point rhs) {
+            const double dx = lhs.x - rhs.x;
+            const double dy = lhs.y - rhs.y;
+            return dx * dx + dy * dy;
+        }
+
+        // Квадрат расстояния от point до отрезка from-to
+        double SquaredSegmentDistance(svg::Point point, svg::Point from, svg::Point to) {
+            const double length = SquaredDistance(from, to);
+            if (length == 0.0) {
+                return SquaredDistance(point, from);
             }
-            line.SetStrokeColor(render_settings_.color_palette[colorNumber]);
-            line.SetFillColor("none");
-            line.SetStrokeWidth(render_settings_.line_width);
-            line.SetStrokeLineCap(svg::StrokeLineCap::ROUND);
-            line.SetStrokeLineJoin(svg::StrokeLineJoin::ROUND);
+            const double t = std::clamp(((point.x - from.x) * (to.x - from.x) + (point.y - from.y) * (to.y - from.y)) / length, 0.0, 1.0);
+            return SquaredDistance(point, { from.x + (to.x - from.x) * t, from.y + (to.y - from.y) * t });
+        }
 
-            if (colorNumber < (render_settings_.color_palette.size() - 1))
-            {
-                colorNumber++;
+        // Алгоритм Дугласа-Пекера: точка удаляется, если вся отброшенная часть линии
+        // отстоит от заменившего её отрезка не больше чем на tolerance. Первая и последняя
+        // точки сохраняются. Рекурсия заменена стеком, так как линии бывают очень длинными
+        void SimplifyPolyline(std::vector<svg::Point>& points, double tolerance) {
+            if (points.size() < 3) {
+                return;
             }
-            else {
-                colorNumber = 0;
+            const double squared_tolerance = tolerance * tolerance;
+            // Буферы переиспользуются между вызовами в одном потоке
+            thread_local std::vector<bool> keep;
+            thread_local std::vector<std::pair<size_t, size_t>> ranges;
+            keep.assign(points.size(), false);
+            keep.front() = true;
+            keep.back() = true;
+            ranges.clear();
+            ranges.emplace_back(0, points.size() - 1);
+            while (!ranges.empty()) {
+                const auto [first, last] = ranges.back();
+                ranges.pop_back();
+                double max_distance = 0.0;
+                size_t farthest = first;
+                for (size_t i = first + 1; i < last; ++i) {
+                    const double distance = SquaredSegmentDistance(points[i], points[first], points[last]);
+                    if (distance > max_distance) {
+                        max_distance = distance;
+                        farthest = i;
+                    }
+                }
+                if (max_distance > squared_tolerance) {
+                    keep[farthest] = true;
+                    ranges.emplace_back(first, farthest);
+                    ranges.emplace_back(farthest, last);
+                }
             }
 
-            result.push_back(line);
+            size_t kept = 0;
+            for (size_t i = 0; i < points.size(); ++i) {
+                if (keep[i]) {
+                    points[kept++] = points[i];
+                }
+            }
+            points.resize(kept);
         }
+    }  // namespace
 
-        return result;
+    template <typename Sink>
+    void MapRenderer::DrawBusLine(svg::Polyline& line, std::vector<svg::Point>& points, Sink& sink) const {
+        if (render_settings_.polyline_tolerance > 0.0) {
+            SimplifyPolyline(points, render_settings_.polyline_tolerance);
+        }
+        line.ClearPoints();
+        for (const svg::Point point : points) {
+            line.AddPoint(point);
+        }
+        sink.Add(line);
     }
 
-    std::vector<svg::Text> MapRenderer::GetBusNameText(const std::map<std::string_view, const transport_catalogue::Bus*>& buses,
-        const SphereProjector& sphereProjector) const {
-        std::vector<svg::Text> result;
-        size_t colorNumber = 0;
+    template <typename Sink>
+    void MapRenderer::DrawBusPolylines(std::span<const transport_catalogue::Bus* const> buses, size_t first_bus_number,
+        const SphereProjector& sphereProjector, Sink& sink) const {
+        svg::Polyline line = MakeBusLine();
+        std::vector<svg::Point> points;
+        size_t bus_number = first_bus_number;
+        for (const auto bus : buses) {
+            const auto& stops = bus->stops;
+
+            // Некольцевой маршрут проходится туда и обратно
+            points.clear();
+            for (const auto& stop : stops) {
+                points.push_back(sphereProjector(stop->coods));
+            }
+            if (!bus->is_circle)
+            {
+                for (auto stop = std::next(stops.rbegin()); stop != stops.rend(); ++stop) {
+                    points.push_back(sphereProjector((*stop)->coods));
+                }
+            }
+            line.SetStrokeColor(GetBusColor(bus_number++));
+            DrawBusLine(line, points, sink);
+        }
+    }
 
-        for (const auto& bus : buses)
+    template <typename Sink>
+    void MapRenderer::DrawBusNames(std::span<const transport_catalogue::Bus* const> buses, size_t first_bus_number,
+        const SphereProjector& sphereProjector, Sink& sink) const {
+        auto [underlayerText, nameText] = MakeBusLabel();
+        size_t bus_number = first_bus_number;
+        for (const auto bus : buses)
         {
-            if (bus.second->stops.empty())
+            const auto& stops = bus->stops;
+
+            nameText.SetFillColor(GetBusColor(bus_number++));
+            nameText.SetData(bus->name);
+            underlayerText.SetData(bus->name);
+
+            const svg::Point first = sphereProjector(stops[0]->coods);
+            underlayerText.SetPosition(first);
+            nameText.SetPosition(first);
+            sink.Add(underlayerText);
+            sink.Add(nameText);
+
+            // Название некольцевого маршрута выводится и у конечной остановки
+            if (!bus->is_circle && stops[0] != stops.back())
             {
-                continue;
+                const svg::Point last = sphereProjector(stops.back()->coods);
+                underlayerText.SetPosition(last);
+                nameText.SetPosition(last);
+                sink.Add(underlayerText);
+                sink.Add(nameText);
             }
+        }
+    }
 
-            svg::Text nameText;
-            nameText.SetFillColor(render_settings_.color_palette[colorNumber]);
-            nameText.SetPosition(sphereProjector(bus.second->stops[0]->coods));
-            nameText.SetData((std::string)bus.first);
-            nameText.SetOffset(render_settings_.bus_label_offset);
-            nameText.SetFontFamily("Verdana");
-            nameText.SetFontSize(render_settings_.bus_label_font_size);
-            nameText.SetFontWeight("bold");
+    template <typename Sink>
+    void MapRenderer::DrawStopCircles(std::span<const transport_catalogue::Stop* const> stops,
+        const SphereProjector& sphereProjector, Sink& sink) const {
+        svg::Circle circle;
+        circle.SetRadius(render_settings_.stop_radius);
+        circle.SetFillColor("white");
+
+        for (const auto stop : stops)
+        {
+            circle.SetCenter(sphereProjector(stop->coods));
+            sink.Add(circle);
+        }
+    }
 
+    template <typename Sink>
+    void MapRenderer::DrawStopNames(std::span<const transport_catalogue::Stop* const> stops,
+        const SphereProjector& sphereProjector, Sink& sink) const {
+        svg::Text nameText;
+        nameText.SetOffset(render_settings_.stop_label_offset);
+        nameText.SetFontFamily("Verdana");
+        nameText.SetFontSize(render_settings_.stop_label_font_size);
+        nameText.SetFillColor("black");
+
+        svg::Text underlayerText;
+        underlayerText.SetFontFamily("Verdana");
+        underlayerText.SetFontSize(render_settings_.stop_label_font_size);
+        underlayerText.SetOffset(render_settings_.stop_label_offset);
+        underlayerText.SetFillColor(render_settings_.underlayer_color);
+        underlayerText.SetStrokeColor(render_settings_.underlayer_color);
+        underlayerText.SetStrokeWidth(render_settings_.underlayer_width);
+        underlayerText.SetStrokeLineCap(svg::StrokeLineCap::ROUND);
+        underlayerText.SetStrokeLineJoin(svg::StrokeLineJoin::ROUND);
+
+        for (const auto stop : stops)
+        {
+            const svg::Point position = sphereProjector(stop->coods);
+            underlayerText.SetPosition(position);
+            underlayerText.SetData(stop->name);
+            nameText.SetPosition(position);
+            nameText.SetData(stop->name);
+
+            sink.Add(underlayerText);
+            sink.Add(nameText);
+        }
+    }
 
-            if (colorNumber < (render_settings_.color_palette.size() - 1)) {
-                colorNumber++;
+    MapRenderer::Layout MapRenderer::MakeLayout(const std::map<std::string_view, const transport_catalogue::Bus*>& buses) const {
+        // Проекция строится по всем остановкам маршрутов, с повторами,
+        // на карту выводятся только остановки, через которые проходят маршруты
+        std::vector<const transport_catalogue::Bus*> drawn_buses;
+        std::vector<geo::Coordinates> bus_stopsCoods;
+        std::vector<const transport_catalogue::Stop*> stops;
+        for (const auto& bus : buses) {
+            if (!bus.second->stops.empty()) {
+                drawn_buses.push_back(bus.second);
             }
-            else {
-                colorNumber = 0;
+            for (const auto& stop : bus.second->stops) {
+                bus_stopsCoods.push_back(stop->coods);
+                stops.push_back(stop);
             }
+        }
+        std::sort(stops.begin(), stops.end(), [](const transport_catalogue::Stop* lhs, const transport_catalogue::Stop* rhs) {
+            return lhs->name < rhs->name;
+            });
+        stops.erase(std::unique(stops.begin(), stops.end()), stops.end());
 
+        SphereProjector sphereProjector(bus_stopsCoods.begin(), bus_stopsCoods.end(), render_settings_.width, render_settings_.height, render_settings_.padding);
+        return { std::move(drawn_buses), std::move(stops), sphereProjector };
+    }
 
-            svg::Text underlayerText;
-            underlayerText.SetFontFamily("Verdana");
-            underlayerText.SetFontSize(render_settings_.bus_label_font_size);
-            underlayerText.SetFontWeight("bold");
-            underlayerText.SetData((std::string)bus.first);
-            underlayerText.SetPosition(sphereProjector(bus.second->stops[0]->coods));
-            underlayerText.SetOffset(render_settings_.bus_label_offset);
-            underlayerText.SetFillColor(render_settings_.underlayer_color);
-            underlayerText.SetStrokeColor(render_settings_.underlayer_color);
-            underlayerText.SetStrokeWidth(render_settings_.underlayer_width);
-            underlayerText.SetStrokeLineCap(svg::StrokeLineCap::ROUND);
-            underlayerText.SetStrokeLineJoin(svg::StrokeLineJoin::ROUND);
+    template <typename Sink>
+    void MapRenderer::DrawMap(const Layout& layout, Sink& sink) const {
+        DrawBusPolylines(layout.buses, 0, layout.projector, sink);
+        DrawBusNames(layout.buses, 0, layout.projector, sink);
+        DrawStopCircles(layout.stops, layout.projector, sink);
+        DrawStopNames(layout.stops, layout.projector, sink);
+    }
 
-            result.push_back(underlayerText);
-            result.push_back(nameText);
+    svg::Document MapRenderer::GetSVGDocument(const std::map<std::string_view,
+        const transport_catalogue::Bus*>& buses) const {
+        svg::Document result;
+        DrawMap(MakeLayout(buses), result);
+        return result;
+    }
 
-            if (!bus.second->is_circle && bus.second->stops[0] != bus.second->stops.back())
+    namespace {
+        // Выполняет task(0) ... task(task_count - 1) на thread_count потоках, включая текущий.
+        // Первое исключение из задач выбрасывается после завершения всех задач
+        template <typename Task>
+        void RunTasks(size_t task_count, size_t thread_count, const Task& task) {
+            std::vector<std::exception_ptr> errors(task_count);
+            std::atomic<size_t> next_task = 0;
             {
-                svg::Text nameText_copy(nameText);
-                svg::Text underlayerText_copy(underlayerText);
-
-                nameText_copy.SetPosition(sphereProjector(bus.second->stops.back()->coods));
-                underlayerText_copy.SetPosition(sphereProjector(bus.second->stops.back()->coods));
-                result.push_back(underlayerText_copy);
-                result.push_back(nameText_copy);
+                const auto work = [&]() {
+                    for (size_t index = next_task++; index < task_count; index = next_task++) {
+                        try {
+                            task(index);
+                        }
+                        catch (...) {
+                            errors[index] = std::current_exception();
+                        }
+                    }
+                };
+                std::vector<std::jthread> workers;
+                for (size_t i = 1; i < std::min(thread_count, task_count); ++i) {
+                    workers.emplace_back(work);
+                }
+                work();
+            }
+            for (const auto& error : errors) {
+                if (error) {
+                    std::rethrow_exception(error);
+                }
             }
         }
 
-        return result;
+        // Делит [0, size) на не более чем part_count частей примерно поровну
+        std::vector<std::pair<size_t, size_t>> SplitRange(size_t size, size_t part_count) {
+            std::vector<std::pair<size_t, size_t>> parts;
+            part_count = std::min(part_count, size);
+            for (size_t part = 0; part < part_count; ++part) {
+                parts.emplace_back(size * part / part_count, size * (part + 1) / part_count);
+            }
+            return parts;
+        }
+    }  // namespace
+
+    void MapRenderer::RenderSVG(const std::map<std::string_view, const transport_catalogue::Bus*>& buses, std::ostream& out,
+        size_t thread_count) const {
+        const Layout layout = MakeLayout(buses);
+        if (thread_count > 1) {
+            RenderLayersParallel(layout, out, thread_count);
+            return;
+        }
+        svg::DocumentWriter writer(out);
+        DrawMap(layout, writer);
+        writer.Close();
     }
 
+    void MapRenderer::RenderLayersParallel(const Layout& layout, std::ostream& out, size_t thread_count) const {
+        // Каждый из четырёх слоёв делится на thread_count частей примерно поровну,
+        // части выводятся в свои буферы и разбираются потоками по очереди.
+        // Порядок частей в tasks совпадает с порядком их вывода в документ
+        std::vector<std::function<void(svg::FragmentWriter&)>> tasks;
+        const std::span<const transport_catalogue::Bus* const> buses = layout.buses;
+        const std::span<const transport_catalogue::Stop* const> stops = layout.stops;
+        for (const auto& [first, last] : SplitRange(buses.size(), thread_count)) {
+            tasks.push_back([this, &layout, buses, first, last](svg::FragmentWriter& writer) {
+                DrawBusPolylines(buses.subspan(first, last - first), first, layout.projector, writer);
+                });
+        }
+        for (const auto& [first, last] : SplitRange(buses.size(), thread_count)) {
+            tasks.push_back([this, &layout, buses, first, last](svg::FragmentWriter& writer) {
+                DrawBusNames(buses.subspan(first, last - first), first, layout.projector, writer);
+                });
+        }
+        for (const auto& [first, last] : SplitRange(stops.size(), thread_count)) {
+            tasks.push_back([this, &layout, stops, first, last](svg::FragmentWriter& writer) {
+                DrawStopCircles(stops.subspan(first, last - first), layout.projector, writer);
+                });
+        }
+        for (const auto& [first, last] : SplitRange(stops.size(), thread_count)) {
+            tasks.push_back([this, &layout, stops, first, last](svg::FragmentWriter& writer) {
+                DrawStopNames(stops.subspan(first, last - first), layout.projector, writer);
+                });
+        }
 
-    std::vector<svg::Circle> MapRenderer::GetStopsCircle(const std::map<std::string_view, const transport_catalogue::Stop*>& stops,
-        const SphereProjector& sphereProjector) const {
-        std::vector<svg::Circle> result;
+        std::vector<std::string> fragments(tasks.size());
+        RunTasks(tasks.size(), thread_count, [&](size_t task) {
+            std::ostringstream buffer;
+            svg::FragmentWriter writer(buffer);
+            tasks[task](writer);
+            fragments[task] = std::move(buffer).str();
+            });
+
+        svg::DocumentWriter writer(out);
+        for (const std::string& fragment : fragments) {
+            writer.AddFragment(fragment);
+        }
+        writer.Close();
+    }
 
-        for (const auto& stop : stops)
-        {
-            svg::Circle circle;
-            circle.SetCenter(sphereProjector(stop.second->coods));
-            circle.SetRadius(render_settings_.stop_radius);
-            circle.SetFillColor("white");
-            result.push_back(circle);
+    void MapRenderer::RenderSVG(const std::map<std::string_view, const transport_catalogue::Bus*>& buses, uint64_t version,
+        std::ostream& out, size_t thread_count) const {
+        std::lock_guard lock(fragment_cache_mutex_);
+        FragmentCache& cache = fragment_cache_;
+        if (!cache.layout || cache.version != version) {
+            Layout layout = MakeLayout(buses);
+            // Фрагменты хранят координаты на карте и годятся только для своей проекции
+            if (!cache.layout || !(cache.layout->projector == layout.projector)) {
+                cache.fragments = {};
+            }
+            cache.layout = std::move(layout);
+            cache.version = version;
+            RenderFragments(*cache.layout, cache.fragments, thread_count);
         }
+        WriteFragments(*cache.layout, cache.fragments, out);
+    }
 
-        return result;
+    void MapRenderer::RenderFragments(const Layout& layout, MapFragments& fragments, size_t thread_count) const {
+        // Фрагмент маршрута устаревает, когда маршрут сдвигается в порядке названий
+        // и получает другой цвет палитры. Фрагмент остановки зависит только от проекции
+        std::vector<size_t> bus_numbers;
+        for (size_t bus_number = 0; bus_number < layout.buses.size(); ++bus_number) {
+            const auto bus = layout.buses[bus_number];
+            if (fragments.buses.size() <= bus->id) {
+                fragments.buses.resize(bus->id + 1);
+            }
+            const BusFragment& fragment = fragments.buses[bus->id];
+            if (fragment.bus != bus || fragment.color_index != GetColorIndex(bus_number)) {
+                bus_numbers.push_back(bus_number);
+            }
+        }
+        std::vector<const transport_catalogue::Stop*> stops;
+        for (const auto stop : layout.stops) {
+            if (fragments.stops.size() <= stop->id) {
+                fragments.stops.resize(stop->id + 1);
+            }
+            if (fragments.stops[stop->id].stop != stop) {
+                stops.push_back(stop);
+            }
+        }
+
+        // Каждый фрагмент выводится в свою ячейку fragments, поэтому задачи не пересекаются
+        const auto bus_parts = SplitRange(bus_numbers.size(), thread_count);
+        const auto stop_parts = SplitRange(stops.size(), thread_count);
+        const std::span<const transport_catalogue::Bus* const> buses = layout.buses;
+        RunTasks(bus_parts.size() + stop_parts.size(), thread_count, [&](size_t task) {
+            std::ostringstream buffer;
+            svg::FragmentWriter writer(buffer);
+            const auto take = [&buffer]() {
+                std::string result = std::move(buffer).str();
+                buffer.str({});
+                return result;
+            };
+
+            if (task < bus_parts.size()) {
+                for (size_t i = bus_parts[task].first; i < bus_parts[task].second; ++i) {
+                    const size_t bus_number = bus_numbers[i];
+                    BusFragment& fragment = fragments.buses[buses[bus_number]->id];
+                    DrawBusPolylines(buses.subspan(bus_number, 1), bus_number, layout.projector, writer);
+                    fragment.line = take();
+                    DrawBusNames(buses.subspan(bus_number, 1), bus_number, layout.projector, writer);
+                    fragment.labels = take();
+                    fragment.bus = buses[bus_number];
+                    fragment.color_index = GetColorIndex(bus_number);
+                }
+                return;
+            }
+
+            const auto [first, last] = stop_parts[task - bus_parts.size()];
+            for (size_t i = first; i < last; ++i) {
+                StopFragment& fragment = fragments.stops[stops[i]->id];
+                DrawStopCircles(std::span(stops).subspan(i, 1), layout.projector, writer);
+                fragment.circle = take();
+                DrawStopNames(std::span(stops).subspan(i, 1), layout.projector, writer);
+                fragment.label = take();
+                fragment.stop = stops[i];
+            }
+            });
     }
 
+    void MapRenderer::WriteFragments(const Layout& layout, const MapFragments& fragments, std::ostream& out) {
+        svg::DocumentWriter writer(out);
+        for (const auto bus : layout.buses) {
+            writer.AddFragment(fragments.buses[bus->id].line);
+        }
+        for (const auto bus : layout.buses) {
+            writer.AddFragment(fragments.buses[bus->id].labels);
+        }
+        for (const auto stop : layout.stops) {
+            writer.AddFragment(fragments.stops[stop->id].circle);
+        }
+        for (const auto stop : layout.stops) {
+            writer.AddFragment(fragments.stops[stop->id].label);
+        }
+        writer.Close();
+    }
 
-    std::vector<svg::Text> MapRenderer::GetStopNamesText(const std::map<std::string_view, const transport_catalogue::Stop*>& stops,
-        const SphereProjector& sphereProjector) const {
-        std::vector<svg::Text> result;
+    namespace {
+        // Больше ячеек по стороне сетки не нужно: в ячейке и так остаются единицы остановок
+        constexpr size_t MAX_GRID_SIZE = 64;
 
-        for (const auto& stop : stops)
-        {
-            svg::Text nameText;
-            nameText.SetPosition(sphereProjector(stop.second->coods));
-            nameText.SetData((std::string)stop.first);
-            nameText.SetOffset(render_settings_.stop_label_offset);
-            nameText.SetFontFamily("Verdana");
-            nameText.SetFontSize(render_settings_.stop_label_font_size);
-            //nameText.SetFontWeight("bold");
-            nameText.SetFillColor("black");
-
-
-
-            svg::Text underlayerText;
-            underlayerText.SetFontFamily("Verdana");
-            underlayerText.SetFontSize(render_settings_.stop_label_font_size);
-            //underlayerText.SetFontWeight("bold");
-            underlayerText.SetData((std::string)stop.first);
-            underlayerText.SetPosition(sphereProjector(stop.second->coods));
-            underlayerText.SetOffset(render_settings_.stop_label_offset);
-            underlayerText.SetFillColor(render_settings_.underlayer_color);
-            underlayerText.SetStrokeColor(render_settings_.underlayer_color);
-            underlayerText.SetStrokeWidth(render_settings_.underlayer_width);
-            underlayerText.SetStrokeLineCap(svg::StrokeLineCap::ROUND);
-            underlayerText.SetStrokeLineJoin(svg::StrokeLineJoin::ROUND);
-
-            result.push_back(underlayerText);
-            result.push_back(nameText);
+        // Число точек линии маршрута: некольцевой маршрут проходится туда и обратно
+        size_t PathLength(const transport_catalogue::Bus& bus) {
+            return bus.is_circle ? bus.stops.size() : bus.stops.size() * 2 - 1;
         }
 
-        return result;
-    }
+        const transport_catalogue::Stop* PathStop(const transport_catalogue::Bus& bus, size_t position) {
+            const size_t size = bus.stops.size();
+            return position < size ? bus.stops[position] : bus.stops[2 * size - 2 - position];
+        }
 
-    svg::Document MapRenderer::GetSVGDocument(const std::map<std::string_view,
-        const transport_catalogue::Bus*>& buses) const {
-        svg::Document result;
-        std::vector<geo::Coordinates> bus_stopsCoods;
-        std::map<std::string_view, const transport_catalogue::Stop*> stops_;
+        // Номер ячейки сетки для значения из [min, max]
+        size_t GridIndex(double value, double min, double max, size_t grid_size) {
+            if (IsZero(max - min)) {
+                return 0;
+            }
+            const double index = std::floor((value - min) / (max - min) * static_cast<double>(grid_size));
+            return static_cast<size_t>(std::clamp(index, 0.0, static_cast<double>(grid_size - 1)));
+        }
+
+        // Отсекает части отрезка from-to вне rect (алгоритм Лианга-Барски). Возвращает
+        // параметры начала и конца видимой части (0 - from, 1 - to) или std::nullopt
+        std::optional<std::pair<double, double>> ClipSegment(const GeoRect& rect, geo::Coordinates from, geo::Coordinates to) {
+            const double d_lng = to.lng - from.lng;
+            const double d_lat = to.lat - from.lat;
+            const std::array<std::pair<double, double>, 4> edges = { {
+                { -d_lng, from.lng - rect.min_lng },
+                { d_lng, rect.max_lng - from.lng },
+                { -d_lat, from.lat - rect.min_lat },
+                { d_lat, rect.max_lat - from.lat },
+            } };
+            double t0 = 0.0;
+            double t1 = 1.0;
+            for (const auto& [p, q] : edges) {
+                if (p == 0.0) {
+                    if (q < 0.0) {
+                        return std::nullopt;
+                    }
+                    continue;
+                }
+                const double t = q / p;
+                if (p < 0.0) {
+                    if (t > t1) {
+                        return std::nullopt;
+                    }
+                    t0 = std::max(t0, t);
+                }
+                else {
+                    if (t < t0) {
+                        return std::nullopt;
+                    }
+                    t1 = std::min(t1, t);
+                }
+            }
+            return std::pair{ t0, t1 };
+        }
+
+        geo::Coordinates Interpolate(geo::Coordinates from, geo::Coordinates to, double t) {
+            return { from.lat + (to.lat - from.lat) * t, from.lng + (to.lng - from.lng) * t };
+        }
+    }  // namespace
+
+    MapIndex::MapIndex(const std::map<std::string_view, const transport_catalogue::Bus*>& buses) {
+        std::vector<const transport_catalogue::Stop*> stops;
         for (const auto& bus : buses) {
-            for (const auto& stop : bus.second->stops) {
-                bus_stopsCoods.push_back(stop->coods);
-                stops_[stop->name] = stop;
+            if (bus.second->stops.empty()) {
+                continue;
+            }
+            buses_.push_back(bus.second);
+            for (const auto stop : bus.second->stops) {
+                if (stops.empty()) {
+                    bounds_ = { stop->coods.lat, stop->coods.lng, stop->coods.lat, stop->coods.lng };
+                }
+                bounds_.min_lat = std::min(bounds_.min_lat, stop->coods.lat);
+                bounds_.min_lng = std::min(bounds_.min_lng, stop->coods.lng);
+                bounds_.max_lat = std::max(bounds_.max_lat, stop->coods.lat);
+                bounds_.max_lng = std::max(bounds_.max_lng, stop->coods.lng);
+                stops.push_back(stop);
             }
         }
-        SphereProjector sphereProjector(bus_stopsCoods.begin(), bus_stopsCoods.end(), render_settings_.width, render_settings_.height, render_settings_.padding);
-        for (const auto& line : GetBusPolylines(buses, sphereProjector)) {
-            result.Add(line);
+        std::sort(stops.begin(), stops.end(), [](const transport_catalogue::Stop* lhs, const transport_catalogue::Stop* rhs) {
+            return lhs->name < rhs->name;
+            });
+        stops.erase(std::unique(stops.begin(), stops.end()), stops.end());
+
+        grid_size_ = std::clamp<size_t>(static_cast<size_t>(std::ceil(std::sqrt(static_cast<double>(stops.size())))), 1, MAX_GRID_SIZE);
+        cells_.resize(grid_size_ * grid_size_);
+        for (const auto stop : stops) {
+            cells_[Row(stop->coods.lat) * grid_size_ + Column(stop->coods.lng)].stops.push_back(stop);
         }
 
-        for (const auto& busText : GetBusNameText(buses, sphereProjector))
-        {
-            result.Add(busText);
+        for (uint32_t bus = 0; bus < buses_.size(); ++bus) {
+            const transport_catalogue::Bus& route = *buses_[bus];
+            for (uint32_t position = 0; position + 1 < PathLength(route); ++position) {
+                const geo::Coordinates from = PathStop(route, position)->coods;
+                const geo::Coordinates to = PathStop(route, position + 1)->coods;
+                const size_t from_column = Column(from.lng);
+                const size_t to_column = Column(to.lng);
+                const size_t from_row = Row(from.lat);
+                const size_t to_row = Row(to.lat);
+                for (size_t row = std::min(from_row, to_row); row <= std::max(from_row, to_row); ++row) {
+                    for (size_t column = std::min(from_column, to_column); column <= std::max(from_column, to_column); ++column) {
+                        cells_[row * grid_size_ + column].segments.push_back({ bus, position });
+                    }
+                }
+            }
+
+            const geo::Coordinates first = route.stops.front()->coods;
+            cells_[Row(first.lat) * grid_size_ + Column(first.lng)].labels.push_back({ bus, false });
+            if (!route.is_circle && route.stops.front() != route.stops.back()) {
+                const geo::Coordinates last = route.stops.back()->coods;
+                cells_[Row(last.lat) * grid_size_ + Column(last.lng)].labels.push_back({ bus, true });
+            }
         }
+    }
 
-        for (const auto& stopCircle : GetStopsCircle(stops_, sphereProjector))
-        {
-            result.Add(stopCircle);
+    size_t MapIndex::Column(double lng) const {
+        return GridIndex(lng, bounds_.min_lng, bounds_.max_lng, grid_size_);
+    }
+
+    size_t MapIndex::Row(double lat) const {
+        // Строки, как и на карте, идут с севера на юг
+        return GridIndex(-lat, -bounds_.max_lat, -bounds_.min_lat, grid_size_);
+    }
+
+    const GeoRect& MapIndex::GetBounds() const {
+        return bounds_;
+    }
+
+    std::optional<GeoRect> MapIndex::GetTileRect(const Tile& tile) const {
+        constexpr int MAX_ZOOM = 30;
+        if (tile.z < 0 || tile.z > MAX_ZOOM) {
+            return std::nullopt;
+        }
+        const int tile_count = 1 << tile.z;
+        if (tile.x < 0 || tile.x >= tile_count || tile.y < 0 || tile.y >= tile_count) {
+            return std::nullopt;
         }
+        const double lat_step = (bounds_.max_lat - bounds_.min_lat) / tile_count;
+        const double lng_step = (bounds_.max_lng - bounds_.min_lng) / tile_count;
+        return GeoRect{
+            bounds_.max_lat - (tile.y + 1) * lat_step,
+            bounds_.min_lng + tile.x * lng_step,
+            bounds_.max_lat - tile.y * lat_step,
+            bounds_.min_lng + (tile.x + 1) * lng_step,
+        };
+    }
 
-        for (const auto& stopText : GetStopNamesText(stops_, sphereProjector))
-        {
-            result.Add(stopText);
+    MapIndex::Selection MapIndex::Select(const GeoRect& rect) const {
+        Selection result;
+        if (buses_.empty() || rect.max_lat < bounds_.min_lat || rect.min_lat > bounds_.max_lat
+            || rect.max_lng < bounds_.min_lng || rect.min_lng > bounds_.max_lng) {
+            return result;
+        }
+
+        const size_t first_column = Column(std::max(rect.min_lng, bounds_.min_lng));
+        const size_t last_column = Column(std::min(rect.max_lng, bounds_.max_lng));
+        const size_t first_row = Row(std::min(rect.max_lat, bounds_.max_lat));
+        const size_t last_row = Row(std::max(rect.min_lat, bounds_.min_lat));
+        for (size_t row = first_row; row <= last_row; ++row) {
+            for (size_t column = first_column; column <= last_column; ++column) {
+                const Cell& cell = cells_[row * grid_size_ + column];
+                // Отрезок может задевать прямоугольник ячейки, не задевая rect. Такие отрезки
+                // отбрасываются при отсечении
+                result.segments.insert(result.segments.end(), cell.segments.begin(), cell.segments.end());
+                for (const auto stop : cell.stops) {
+                    if (rect.Contains(stop->coods)) {
+                        result.stops.push_back(stop);
+                    }
+                }
+                for (const Label& label : cell.labels) {
+                    if (rect.Contains(GetLabelPoint(label))) {
+                        result.labels.push_back(label);
+                    }
+                }
+            }
         }
 
+        // Длинный отрезок записан в несколько ячеек
+        auto segment_key = [](const Segment& segment) {
+            return std::pair{ segment.bus, segment.position };
+        };
+        std::sort(result.segments.begin(), result.segments.end(), [&segment_key](const Segment& lhs, const Segment& rhs) {
+            return segment_key(lhs) < segment_key(rhs);
+            });
+        result.segments.erase(std::unique(result.segments.begin(), result.segments.end(), [&segment_key](const Segment& lhs, const Segment& rhs) {
+            return segment_key(lhs) == segment_key(rhs);
+            }), result.segments.end());
+        std::sort(result.labels.begin(), result.labels.end(), [](const Label& lhs, const Label& rhs) {
+            return std::pair{ lhs.bus, lhs.at_end } < std::pair{ rhs.bus, rhs.at_end };
+            });
+        std::sort(result.stops.begin(), result.stops.end(), [](const transport_catalogue::Stop* lhs, const transport_catalogue::Stop* rhs) {
+            return lhs->name < rhs->name;
+            });
         return result;
     }
+
+    const transport_catalogue::Bus& MapIndex::GetBus(uint32_t bus) const {
+        return *buses_[bus];
+    }
+
+    geo::Coordinates MapIndex::GetPoint(const Segment& segment) const {
+        return PathStop(*buses_[segment.bus], segment.position)->coods;
+    }
+
+    geo::Coordinates MapIndex::GetLabelPoint(const Label& label) const {
+        const transport_catalogue::Bus& bus = *buses_[label.bus];
+        return (label.at_end ? bus.stops.back() : bus.stops.front())->coods;
+    }
+
+    void MapRenderer::RenderRegionSVG(const MapIndex& index, const GeoRect& region, std::ostream& out) const {
+        const std::array corners{ geo::Coordinates{ region.min_lat, region.min_lng }, geo::Coordinates{ region.max_lat, region.max_lng } };
+        const SphereProjector sphereProjector(corners.begin(), corners.end(), render_settings_.width, render_settings_.height, render_settings_.padding);
+        const MapIndex::Selection selection = index.Select(region);
+
+        svg::DocumentWriter writer(out);
+
+        // Линия маршрута обрывается там, где выходит из region, и продолжается
+        // новой линией, если возвращается
+        svg::Polyline line = MakeBusLine();
+        std::vector<svg::Point> points;
+        // Последний отрезок текущей линии, если линия на нём не обрезана
+        MapIndex::Segment last_segment;
+        bool line_open = false;
+        for (const MapIndex::Segment& segment : selection.segments) {
+            const geo::Coordinates from = index.GetPoint(segment);
+            const geo::Coordinates to = index.GetPoint({ segment.bus, segment.position + 1 });
+            const auto visible = ClipSegment(region, from, to);
+            if (!visible) {
+                line_open = false;
+                continue;
+            }
+            const auto [t0, t1] = *visible;
+            const bool continues = line_open && last_segment.bus == segment.bus
+                && last_segment.position + 1 == segment.position && t0 == 0.0;
+            if (!continues) {
+                if (!points.empty()) {
+                    DrawBusLine(line, points, writer);
+                }
+                points.clear();
+                line.SetStrokeColor(GetBusColor(segment.bus));
+                points.push_back(sphereProjector(Interpolate(from, to, t0)));
+            }
+            points.push_back(sphereProjector(Interpolate(from, to, t1)));
+            last_segment = segment;
+            line_open = t1 == 1.0;
+        }
+        if (!points.empty()) {
+            DrawBusLine(line, points, writer);
+        }
+
+        auto [underlayerText, nameText] = MakeBusLabel();
+        for (const MapIndex::Label& label : selection.labels) {
+            const std::string_view name = index.GetBus(label.bus).name;
+            const svg::Point position = sphereProjector(index.GetLabelPoint(label));
+            underlayerText.SetData(name).SetPosition(position);
+            nameText.SetData(name).SetPosition(position).SetFillColor(GetBusColor(label.bus));
+            writer.Add(underlayerText);
+            writer.Add(nameText);
+        }
+
+        DrawStopCircles(selection.stops, sphereProjector, writer);
+        DrawStopNames(selection.stops, sphereProjector, writer);
+        writer.Close();
+    }
 }
\ No newline at end of file
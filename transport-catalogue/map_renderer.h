@@ -8,9 +8,14 @@
 #include <algorithm>
 #include <cstdlib>
 #include <iostream>
+#include <cstdint>
 #include <optional>
+#include <span>
+#include <variant>
 #include <vector>
 #include <map>
+#include <mutex>
+#include <string>
 
 
 namespace renderer {
@@ -79,6 +84,9 @@ namespace renderer {
             };
         }
 
+        // Одинаковые проекции переводят точки в одни и те же координаты
+        bool operator==(const SphereProjector& other) const = default;
+
     private:
         double padding_;
         double min_lon_ = 0;
@@ -86,6 +94,87 @@ namespace renderer {
         double zoom_coeff_ = 0;
     };
 
+    // Прямоугольник в географических координатах
+    struct GeoRect {
+        double min_lat = 0.0;
+        double min_lng = 0.0;
+        double max_lat = 0.0;
+        double max_lng = 0.0;
+
+        bool Contains(geo::Coordinates point) const {
+            return point.lat >= min_lat && point.lat <= max_lat && point.lng >= min_lng && point.lng <= max_lng;
+        }
+    };
+
+    // Тайл карты: прямоугольник, охватывающий все остановки маршрутов, делится
+    // на 2^z x 2^z равных частей. x отсчитывается с запада, y - с севера
+    struct Tile {
+        int z = 0;
+        int x = 0;
+        int y = 0;
+    };
+
+    // Часть карты в запросе Map: вся карта (std::monostate), прямоугольник или тайл
+    using MapArea = std::variant<std::monostate, GeoRect, Tile>;
+
+    // Пространственный индекс маршрутов для отрисовки части карты: равномерная сетка
+    // над остановками. Ячейка хранит свои остановки, подписи маршрутов у своих конечных
+    // остановок и отрезки маршрутов, ограничивающий прямоугольник которых её задевает.
+    // Строится по тем же маршрутам, что и карта целиком, и ссылается на них
+    class MapIndex {
+    public:
+        // Отрезок линии маршрута от точки position до position + 1.
+        // Линия некольцевого маршрута проходит остановки туда и обратно
+        struct Segment {
+            uint32_t bus = 0;
+            uint32_t position = 0;
+        };
+
+        // Подпись маршрута у первой (at_end == false) или конечной остановки
+        struct Label {
+            uint32_t bus = 0;
+            bool at_end = false;
+        };
+
+        // То, что нужно нарисовать в прямоугольнике, в порядке вывода на карту:
+        // отрезки и подписи по маршрутам, остановки по названию
+        struct Selection {
+            std::vector<Segment> segments;
+            std::vector<Label> labels;
+            std::vector<const transport_catalogue::Stop*> stops;
+        };
+
+        explicit MapIndex(const std::map<std::string_view, const transport_catalogue::Bus*>& buses);
+
+        // Прямоугольник, охватывающий все остановки маршрутов
+        const GeoRect& GetBounds() const;
+
+        // Прямоугольник тайла или std::nullopt, если такого тайла нет
+        std::optional<GeoRect> GetTileRect(const Tile& tile) const;
+
+        Selection Select(const GeoRect& rect) const;
+
+        // Маршруты с остановками по названию; номер маршрута задаёт его цвет
+        const transport_catalogue::Bus& GetBus(uint32_t bus) const;
+        geo::Coordinates GetPoint(const Segment& segment) const;
+        geo::Coordinates GetLabelPoint(const Label& label) const;
+
+    private:
+        struct Cell {
+            std::vector<const transport_catalogue::Stop*> stops;
+            std::vector<Segment> segments;
+            std::vector<Label> labels;
+        };
+
+        size_t Column(double lng) const;
+        size_t Row(double lat) const;
+
+        std::vector<const transport_catalogue::Bus*> buses_;
+        GeoRect bounds_;
+        size_t grid_size_ = 1;
+        std::vector<Cell> cells_;
+    };
+
     struct RenderSettings {
         double width = 0.0;
         double height = 0.0;
@@ -99,6 +188,9 @@ namespace renderer {
         svg::Color underlayer_color = { svg::NoneColor };
         double underlayer_width = 0.0;
         std::vector<svg::Color> color_palette{};
+        // Допустимое отклонение упрощённой линии маршрута от исходной в пикселях
+        // (ключ polyline_tolerance). 0 - линии выводятся без упрощения
+        double polyline_tolerance = 0.0;
     };
 
     class MapRenderer
@@ -110,17 +202,112 @@ namespace renderer {
 
         svg::Document GetSVGDocument(const std::map<std::string_view, const transport_catalogue::Bus*>& buses) const;
 
+        // Выводит в out ту же карту, что и GetSVGDocument, по мере её построения:
+        // без документа и без отдельного объекта на каждый элемент карты.
+        // При thread_count > 1 слои карты, разбитые на части по маршрутам и остановкам,
+        // выводятся на нескольких потоках в отдельные буферы и затем склеиваются по порядку
+        void RenderSVG(const std::map<std::string_view, const transport_catalogue::Bus*>& buses, std::ostream& out,
+            size_t thread_count = 1) const;
+
+        // Выводит ту же карту, что и RenderSVG, сохраняя выведенные маршруты и остановки
+        // для следующих вызовов. version - версия справочника, из которого взяты buses.
+        // При прежней версии карта целиком собирается из сохранённых фрагментов, при новой
+        // заново выводятся только маршруты и остановки, которых не было на карте, и маршруты,
+        // сменившие цвет из-за сдвига в порядке названий. Если новые остановки изменили
+        // проекцию карты, выводится вся карта. Каждый элемент хранится отдельной строкой,
+        // поэтому первая отрисовка дороже, чем у RenderSVG: этот вариант нужен, только если
+        // справочник дополняется после загрузки
+        void RenderSVG(const std::map<std::string_view, const transport_catalogue::Bus*>& buses, uint64_t version,
+            std::ostream& out, size_t thread_count = 1) const;
+
+        // Выводит часть карты: объекты, попадающие в region, в масштабе, при котором
+        // region занимает всё изображение. Линии маршрутов обрезаются по границе region,
+        // цвета маршрутов те же, что на всей карте
+        void RenderRegionSVG(const MapIndex& index, const GeoRect& region, std::ostream& out) const;
+
     private:
-        std::vector<svg::Polyline> GetBusPolylines(const std::map<std::string_view, const transport_catalogue::Bus*>& buses,
-            const SphereProjector& sphereProjector) const;
-        std::vector<svg::Text> GetBusNameText(const std::map<std::string_view, const transport_catalogue::Bus*>& buses,
-            const SphereProjector& sphereProjector) const;
-        std::vector<svg::Circle> GetStopsCircle(const std::map<std::string_view, const transport_catalogue::Stop*>& stops,
-            const SphereProjector& sphereProjector) const;
-        std::vector<svg::Text> GetStopNamesText(const std::map<std::string_view, const transport_catalogue::Stop*>& stops,
-            const SphereProjector& sphereProjector) const;
+        // Объекты с общими для всех элементов слоя свойствами
+        svg::Polyline MakeBusLine() const;
+        // Подложка и надпись
+        std::pair<svg::Text, svg::Text> MakeBusLabel() const;
+        const svg::Color& GetBusColor(size_t bus_number) const;
+        size_t GetColorIndex(size_t bus_number) const;
+
+        // Упрощает points с допуском polyline_tolerance, записывает их в line
+        // и передаёт line в sink
+        template <typename Sink>
+        void DrawBusLine(svg::Polyline& line, std::vector<svg::Point>& points, Sink& sink) const;
+
+        // Всё, от чего зависят слои карты: маршруты с остановками по названию
+        // (номер маршрута в buses задаёт его цвет), остановки на них по названию и проекция
+        struct Layout {
+            std::vector<const transport_catalogue::Bus*> buses;
+            std::vector<const transport_catalogue::Stop*> stops;
+            SphereProjector projector;
+        };
+
+        Layout MakeLayout(const std::map<std::string_view, const transport_catalogue::Bus*>& buses) const;
+
+        void RenderLayersParallel(const Layout& layout, std::ostream& out, size_t thread_count) const;
+
+        // Выведенные элементы карты в том виде, в котором они входят в документ
+        struct BusFragment {
+            const transport_catalogue::Bus* bus = nullptr;
+            size_t color_index = 0;
+            std::string line;
+            // Подложки и названия у начальной и конечной остановок
+            std::string labels;
+        };
+
+        struct StopFragment {
+            const transport_catalogue::Stop* stop = nullptr;
+            std::string circle;
+            std::string label;
+        };
+
+        // Фрагменты одной проекции карты
+        struct MapFragments {
+            // По Bus::id
+            std::vector<BusFragment> buses;
+            // По Stop::id
+            std::vector<StopFragment> stops;
+        };
+
+        // Выводит в fragments недостающие и устаревшие элементы layout,
+        // при thread_count > 1 - на нескольких потоках
+        void RenderFragments(const Layout& layout, MapFragments& fragments, size_t thread_count) const;
+        // Собирает документ из фрагментов в порядке слоёв карты
+        static void WriteFragments(const Layout& layout, const MapFragments& fragments, std::ostream& out);
+
+        // Слои карты передаются в sink (svg::Document, svg::DocumentWriter или
+        // svg::FragmentWriter) по одному объекту. Внутри слоя объект переиспользуется,
+        // меняются только его координаты и текст.
+        // first_bus_number - номер первого из buses среди всех маршрутов карты
+        template <typename Sink>
+        void DrawMap(const Layout& layout, Sink& sink) const;
+        template <typename Sink>
+        void DrawBusPolylines(std::span<const transport_catalogue::Bus* const> buses, size_t first_bus_number,
+            const SphereProjector& sphereProjector, Sink& sink) const;
+        template <typename Sink>
+        void DrawBusNames(std::span<const transport_catalogue::Bus* const> buses, size_t first_bus_number,
+            const SphereProjector& sphereProjector, Sink& sink) const;
+        template <typename Sink>
+        void DrawStopCircles(std::span<const transport_catalogue::Stop* const> stops,
+            const SphereProjector& sphereProjector, Sink& sink) const;
+        template <typename Sink>
+        void DrawStopNames(std::span<const transport_catalogue::Stop* const> stops,
+            const SphereProjector& sphereProjector, Sink& sink) const;
 
     private:
         const RenderSettings render_settings_;
+
+        struct FragmentCache {
+            uint64_t version = 0;
+            std::optional<Layout> layout;
+            MapFragments fragments;
+        };
+
+        mutable std::mutex fragment_cache_mutex_;
+        mutable FragmentCache fragment_cache_;
     };
 }
\ No newline at end of file
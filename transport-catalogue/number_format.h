@@ -0,0 +1,30 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <charconv>
+#include <cstddef>
+#include <ios>
+#include <string_view>
+
+namespace number_format {
+
+    // Больше значащих цифр double не содержит
+    inline constexpr std::streamsize MAX_PRECISION = 17;
+
+    // Вмещает любой double в формате general с точностью до MAX_PRECISION:
+    // знак, 17 цифр, точка и порядок вида e-308
+    using DoubleBuffer = std::array<char, 32>;
+
+    // Форматирует value через std::to_chars так же, как operator<< потока с флагами
+    // по умолчанию и точностью stream_precision (%g), и возвращает записанную в buffer часть.
+    // Точность больше MAX_PRECISION сокращается до неё: 17 цифр однозначно задают double.
+    // json и svg выводят числа только через эту функцию
+    inline std::string_view FormatDouble(double value, std::streamsize stream_precision, DoubleBuffer& buffer) {
+        const int precision = static_cast<int>(std::min(stream_precision, MAX_PRECISION));
+        const auto result = std::to_chars(buffer.data(), buffer.data() + buffer.size(), value,
+            std::chars_format::general, precision);
+        return { buffer.data(), static_cast<size_t>(result.ptr - buffer.data()) };
+    }
+
+}  // namespace number_format
@@ -0,0 +1,256 @@
+#include "request_capture.h"
+
+#include "request_handler.h"
+
+#include <algorithm>
+#include <bit>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <variant>
+
+namespace request_handler {
+
+    namespace {
+        using namespace std::literals;
+
+        constexpr std::string_view CAPTURE_HEADER = "TCCAPTURE2\n"sv;
+
+        // Названия остановок и маршрутов намного короче. Длина строки читается из файла,
+        // и без ограничения повреждённый файл мог бы запросить сколько угодно памяти
+        constexpr uint64_t MAX_STRING_SIZE = 64 * 1024;
+
+        void WriteVarint(std::ostream& output, uint64_t value) {
+            while (value >= 0x80) {
+                output.put(static_cast<char>((value & 0x7F) | 0x80));
+                value >>= 7;
+            }
+            output.put(static_cast<char>(value));
+        }
+
+        void WriteString(std::ostream& output, std::string_view value) {
+            WriteVarint(output, value.size());
+            output.write(value.data(), static_cast<std::streamsize>(value.size()));
+        }
+
+        // Возвращает false, если поток закончился до начала числа
+        bool ReadVarint(std::istream& input, uint64_t& value) {
+            value = 0;
+            for (int shift = 0; shift < 64; shift += 7) {
+                const int c = input.get();
+                if (c == std::char_traits<char>::eof()) {
+                    if (shift == 0) {
+                        return false;
+                    }
+                    throw std::runtime_error("Capture is truncated"s);
+                }
+                value |= static_cast<uint64_t>(c & 0x7F) << shift;
+                if ((c & 0x80) == 0) {
+                    return true;
+                }
+            }
+            throw std::runtime_error("Capture is corrupted: varint is too long"s);
+        }
+
+        uint64_t ReadRequiredVarint(std::istream& input) {
+            uint64_t value = 0;
+            if (!ReadVarint(input, value)) {
+                throw std::runtime_error("Capture is truncated"s);
+            }
+            return value;
+        }
+
+        // Позиция конца потока или -1, если поток её не сообщает
+        std::streamoff StreamEnd(std::istream& input) {
+            const auto position = input.tellg();
+            if (position == std::streampos(-1)) {
+                return -1;
+            }
+            input.seekg(0, std::ios::end);
+            const auto end = input.tellg();
+            input.seekg(position);
+            return end == std::streampos(-1) ? -1 : static_cast<std::streamoff>(end);
+        }
+
+        // stream_end - результат StreamEnd: строка не может быть длиннее остатка потока
+        std::string ReadString(std::istream& input, std::streamoff stream_end) {
+            const uint64_t size = ReadRequiredVarint(input);
+            uint64_t max_size = MAX_STRING_SIZE;
+            if (const auto position = input.tellg(); stream_end >= 0 && position != std::streampos(-1)) {
+                max_size = std::min<uint64_t>(max_size, static_cast<uint64_t>(std::max<std::streamoff>(stream_end - position, 0)));
+            }
+            if (size > max_size) {
+                throw std::runtime_error("Capture is corrupted: string length "s + std::to_string(size) + " is too large"s);
+            }
+            std::string value(size, '\0');
+            if (!input.read(value.data(), static_cast<std::streamsize>(size))) {
+                throw std::runtime_error("Capture is truncated"s);
+            }
+            return value;
+        }
+
+        void WriteDouble(std::ostream& output, double value) {
+            const auto bits = std::bit_cast<uint64_t>(value);
+            for (int byte = 0; byte < 8; ++byte) {
+                output.put(static_cast<char>((bits >> (8 * byte)) & 0xFF));
+            }
+        }
+
+        double ReadDouble(std::istream& input) {
+            char bytes[8];
+            if (!input.read(bytes, sizeof(bytes))) {
+                throw std::runtime_error("Capture is truncated"s);
+            }
+            uint64_t bits = 0;
+            for (int byte = 0; byte < 8; ++byte) {
+                bits |= static_cast<uint64_t>(static_cast<unsigned char>(bytes[byte])) << (8 * byte);
+            }
+            return std::bit_cast<double>(bits);
+        }
+
+        // id хранится зигзаг-кодированием, чтобы небольшие отрицательные числа занимали один байт
+        uint64_t ZigZag(int value) {
+            return (static_cast<uint64_t>(static_cast<int64_t>(value)) << 1) ^ static_cast<uint64_t>(static_cast<int64_t>(value) >> 63);
+        }
+
+        int UnZigZag(uint64_t value) {
+            return static_cast<int>(static_cast<int64_t>(value >> 1) ^ -static_cast<int64_t>(value & 1));
+        }
+
+        // Часть карты запроса Map: байт вида (0 - вся карта, 1 - прямоугольник, 2 - тайл) и данные
+        void WriteMapArea(std::ostream& output, const renderer::MapArea& area) {
+            output.put(static_cast<char>(area.index()));
+            if (const auto* rect = std::get_if<renderer::GeoRect>(&area)) {
+                WriteDouble(output, rect->min_lat);
+                WriteDouble(output, rect->min_lng);
+                WriteDouble(output, rect->max_lat);
+                WriteDouble(output, rect->max_lng);
+            }
+            else if (const auto* tile = std::get_if<renderer::Tile>(&area)) {
+                WriteVarint(output, ZigZag(tile->z));
+                WriteVarint(output, ZigZag(tile->x));
+                WriteVarint(output, ZigZag(tile->y));
+            }
+        }
+
+        renderer::MapArea ReadMapArea(std::istream& input) {
+            switch (input.get()) {
+            case 0:
+                return std::monostate{};
+            case 1: {
+                renderer::GeoRect rect;
+                rect.min_lat = ReadDouble(input);
+                rect.min_lng = ReadDouble(input);
+                rect.max_lat = ReadDouble(input);
+                rect.max_lng = ReadDouble(input);
+                return rect;
+            }
+            case 2: {
+                renderer::Tile tile;
+                tile.z = UnZigZag(ReadRequiredVarint(input));
+                tile.x = UnZigZag(ReadRequiredVarint(input));
+                tile.y = UnZigZag(ReadRequiredVarint(input));
+                return tile;
+            }
+            default:
+                throw std::runtime_error("Capture is corrupted: unknown map area"s);
+            }
+        }
+    }  // namespace
+
+    RequestCapture::RequestCapture(std::ostream& output)
+        : output_(output)
+        , start_(RequestStats::Clock::now()) {
+        output_ << CAPTURE_HEADER;
+    }
+
+    void RequestCapture::Record(const json_reader::StatRequest& request) {
+        std::lock_guard lock(mutex_);
+        // Время берётся под мьютексом, поэтому приращения не бывают отрицательными
+        const auto time = RequestStats::Clock::now() - start_;
+        const auto delta = std::chrono::duration_cast<std::chrono::nanoseconds>(time - last_time_).count();
+        last_time_ = time;
+
+        WriteVarint(output_, static_cast<uint64_t>(delta));
+        output_.put(static_cast<char>(request.type));
+        WriteVarint(output_, ZigZag(request.id));
+        switch (request.type) {
+        case json_reader::RequestType::STOP:
+        case json_reader::RequestType::BUS:
+            WriteString(output_, request.name);
+            break;
+        case json_reader::RequestType::ROUTE:
+            WriteString(output_, request.from);
+            WriteString(output_, request.to);
+            break;
+        case json_reader::RequestType::MAP:
+            WriteMapArea(output_, request.area);
+            break;
+        default:
+            break;
+        }
+    }
+
+    std::vector<CapturedRequest> ReadCapture(std::istream& input) {
+        std::string header(CAPTURE_HEADER.size(), '\0');
+        if (!input.read(header.data(), static_cast<std::streamsize>(header.size())) || header != CAPTURE_HEADER) {
+            throw std::runtime_error("Not a request capture"s);
+        }
+
+        const std::streamoff stream_end = StreamEnd(input);
+        std::vector<CapturedRequest> requests;
+        std::chrono::nanoseconds time{ 0 };
+        for (uint64_t delta = 0; ReadVarint(input, delta);) {
+            time += std::chrono::nanoseconds(delta);
+            CapturedRequest& captured = requests.emplace_back();
+            captured.time = time;
+
+            const int type = input.get();
+            if (type < 0 || type > static_cast<int>(json_reader::RequestType::ROUTE)) {
+                throw std::runtime_error("Capture is corrupted: unknown request type"s);
+            }
+            json_reader::StatRequest& request = captured.request;
+            request.type = static_cast<json_reader::RequestType>(type);
+            request.id = UnZigZag(ReadRequiredVarint(input));
+            switch (request.type) {
+            case json_reader::RequestType::STOP:
+            case json_reader::RequestType::BUS:
+                request.name = ReadString(input, stream_end);
+                break;
+            case json_reader::RequestType::ROUTE:
+                request.from = ReadString(input, stream_end);
+                request.to = ReadString(input, stream_end);
+                break;
+            case json_reader::RequestType::MAP:
+                request.area = ReadMapArea(input);
+                break;
+            default:
+                break;
+            }
+        }
+        return requests;
+    }
+
+    void ReplayCapture(const RequestHandler& handler, const std::vector<CapturedRequest>& requests,
+        double speed, RequestStats& stats) {
+        using Clock = RequestStats::Clock;
+
+        std::ostringstream answer;
+        const auto start = Clock::now();
+        for (const CapturedRequest& captured : requests) {
+            auto scheduled = Clock::now();
+            if (speed > 0.0) {
+                scheduled = start + std::chrono::duration_cast<Clock::duration>(captured.time / speed);
+                std::this_thread::sleep_until(scheduled);
+            }
+            answer.str({});
+            json::Writer writer(answer);
+            handler.ReplayRequest(captured.request, writer);
+            stats.RecordRequest(captured.request.type, Clock::now() - scheduled);
+        }
+        stats.RecordBatch(requests.size(), Clock::now() - start);
+    }
+
+}  // namespace request_handler
@@ -0,0 +1,51 @@
+#pragma once
+
+#include "json_reader.h"
+#include "request_stats.h"
+
+#include <chrono>
+#include <iostream>
+#include <mutex>
+#include <vector>
+
+namespace request_handler {
+
+    class RequestHandler;
+
+    // Запись обработанных запросов stat_requests вместе с моментом обработки.
+    // Формат двоичный и компактный: заголовок, затем записи из приращения времени
+    // в наносекундах (varint), типа запроса (байт), id (varint со знаком) и строк
+    // запроса (длина varint и байты) или части карты запроса Map.
+    // Запись может идти из нескольких потоков
+    class RequestCapture {
+    public:
+        explicit RequestCapture(std::ostream& output);
+
+        void Record(const json_reader::StatRequest& request);
+
+    private:
+        std::ostream& output_;
+        std::mutex mutex_;
+        RequestStats::Clock::time_point start_;
+        RequestStats::Clock::duration last_time_{};
+    };
+
+    struct CapturedRequest {
+        // Время от начала записи
+        std::chrono::nanoseconds time;
+        json_reader::StatRequest request;
+    };
+
+    // Читает запись, сделанную RequestCapture. Повреждённый файл приводит к std::runtime_error
+    std::vector<CapturedRequest> ReadCapture(std::istream& input);
+
+    // Повторяет записанные запросы. speed задаёт темп относительно исходного
+    // (1 - как при записи, 2 - вдвое быстрее), при speed <= 0 запросы идут без пауз.
+    // Задержка каждого запроса считается от запланированного момента его отправки,
+    // поэтому отставание от расписания тоже попадает в статистику.
+    // Ответы формируются полностью, но никуда не выводятся. Повторённые запросы попадают
+    // только в stats: статистика и RequestCapture обработчика их не видят
+    void ReplayCapture(const RequestHandler& handler, const std::vector<CapturedRequest>& requests,
+        double speed, RequestStats& stats);
+
+}  // namespace request_handler
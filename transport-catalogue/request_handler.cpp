@@ -1,9 +1,15 @@
 #include "request_handler.h"
+#include "tracing.h"
 
-#include "json_builder.h"
-
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <exception>
 #include <iostream>
+#include <limits>
+#include <mutex>
 #include <sstream>
+#include <thread>
 
 namespace request_handler
 {
@@ -27,29 +33,259 @@ namespace request_handler
         return db_.GetBusesOnStop(*stop);
     }
 
+    namespace {
+        // Потоки забирают запросы блоками: блок достаточно мал для равномерной загрузки
+        // потоков и достаточно велик, чтобы они редко обращались к общему счётчику
+        constexpr size_t CHUNK_SIZE = 32;
+
+        struct AnswerChunk {
+            std::vector<std::string> answers;
+            std::exception_ptr error;
+            bool ready = false;
+        };
+
+        // Номер, которого нет в справочнике
+        constexpr uint32_t UNKNOWN_ID = std::numeric_limits<uint32_t>::max();
+
+        uint32_t StopId(const transport_catalogue::TransportCatalogue& db, std::string_view name) {
+            const auto stop = db.FindStop(name);
+            return stop ? static_cast<uint32_t>(stop->id) : UNKNOWN_ID;
+        }
+
+        uint32_t BusId(const transport_catalogue::TransportCatalogue& db, std::string_view name) {
+            const auto bus = db.FindBus(name);
+            return bus ? static_cast<uint32_t>(bus->id) : UNKNOWN_ID;
+        }
+
+        binary_protocol::Request ToBinaryRequest(const transport_catalogue::TransportCatalogue& db, const json_reader::StatRequest& request) {
+            binary_protocol::Request result;
+            result.id = request.id;
+            result.type = request.type;
+            result.area = request.area;
+            switch (request.type) {
+            case json_reader::RequestType::STOP:
+                result.object = StopId(db, request.name);
+                break;
+            case json_reader::RequestType::BUS:
+                result.object = BusId(db, request.name);
+                break;
+            case json_reader::RequestType::ROUTE:
+                result.object = StopId(db, request.from);
+                result.to = StopId(db, request.to);
+                break;
+            default:
+                break;
+            }
+            return result;
+        }
+
+        // Обратное преобразование нужно только для записи запросов в RequestCapture
+        json_reader::StatRequest ToStatRequest(const transport_catalogue::TransportCatalogue& db, const binary_protocol::Request& request) {
+            auto stop_name = [&db](uint32_t id) {
+                const auto stop = db.GetStop(id);
+                return stop ? stop->name : std::string();
+            };
+            json_reader::StatRequest result;
+            result.id = request.id;
+            result.type = request.type;
+            result.area = request.area;
+            switch (request.type) {
+            case json_reader::RequestType::STOP:
+                result.name = stop_name(request.object);
+                break;
+            case json_reader::RequestType::BUS:
+                if (const auto bus = db.GetBus(request.object)) {
+                    result.name = bus->name;
+                }
+                break;
+            case json_reader::RequestType::ROUTE:
+                result.from = stop_name(request.object);
+                result.to = stop_name(request.to);
+                break;
+            default:
+                break;
+            }
+            return result;
+        }
+    }
+
     void RequestHandler::PrintRequests() const {
-        json::Array requests;
-        const json::Array& arr = reader_.GetStatRequests().AsArray();
-        for (auto& request : arr) {
-            const auto& request_map = request.AsMap();
-            const auto& type = request_map.at("type").AsString();
-            if (type == "Stop") {
-                requests.emplace_back(PrintStop(request_map).AsMap());
+        PrintRequests(reader_.GetStatRequests(), *options_.output);
+    }
+
+    void RequestHandler::PrintRequests(const std::vector<json_reader::StatRequest>& requests, std::ostream& output) const {
+        TRACE_SCOPE("RequestHandler::PrintRequests");
+        const auto start = RequestStats::Clock::now();
+        if (options_.protocol == Protocol::BINARY) {
+            WriteRequests(requests, output);
+        }
+        else {
+            // Ответы выводятся по одному, сразу после обработки запроса
+            json::Writer writer(output);
+            writer.StartArray();
+            if (options_.thread_count > 1 && requests.size() > CHUNK_SIZE) {
+                PrintRequestsParallel(requests, writer);
+            }
+            else {
+                for (const auto& request : requests) {
+                    PrintRequest(request, writer);
+                }
             }
+            writer.EndArray();
+        }
+        if (options_.stats) {
+            options_.stats->RecordBatch(requests.size(), RequestStats::Clock::now() - start);
+        }
+    }
 
-            if (type == "Bus") {
-                requests.emplace_back(PrintBus(request_map).AsMap());
+    void RequestHandler::PrintRequest(const json_reader::StatRequest& request, json::Writer& writer) const {
+        TRACE_REQUEST_SCOPE(json_reader::RequestTypeName(request.type));
+        if (options_.capture) {
+            options_.capture->Record(request);
+        }
+        Measure(request.type, [&] {
+            AnswerRequest(request, writer);
+            });
+    }
+
+    void RequestHandler::ReplayRequest(const json_reader::StatRequest& request, json::Writer& writer) const {
+        TRACE_REQUEST_SCOPE(json_reader::RequestTypeName(request.type));
+        AnswerRequest(request, writer);
+    }
+
+    void RequestHandler::WriteAnswer(const binary_protocol::Request& request, std::string& output) const {
+        TRACE_REQUEST_SCOPE(json_reader::RequestTypeName(request.type));
+        if (options_.capture) {
+            options_.capture->Record(ToStatRequest(db_, request));
+        }
+        Measure(request.type, [&] {
+            WriteAnswerTo(request, output);
+            });
+    }
+
+    void RequestHandler::WriteRequests(const std::vector<json_reader::StatRequest>& requests, std::ostream& output) const {
+        // Ответы копятся в буфере и выводятся блоками
+        constexpr size_t FLUSH_SIZE = 64 * 1024;
+        std::string buffer;
+        for (const auto& request : requests) {
+            TRACE_REQUEST_SCOPE(json_reader::RequestTypeName(request.type));
+            if (options_.capture) {
+                options_.capture->Record(request);
+            }
+            Measure(request.type, [&] {
+                WriteAnswerTo(ToBinaryRequest(db_, request), buffer);
+                });
+            if (buffer.size() >= FLUSH_SIZE) {
+                output.write(buffer.data(), static_cast<std::streamsize>(buffer.size()));
+                buffer.clear();
             }
+        }
+        output.write(buffer.data(), static_cast<std::streamsize>(buffer.size()));
+    }
 
-            if (type == "Map") {
-                requests.emplace_back(PrintMap(request_map).AsMap());
+    void RequestHandler::WriteAnswerTo(const binary_protocol::Request& request, std::string& output) const {
+        switch (request.type) {
+        case json_reader::RequestType::STOP:
+            WriteStop(request, output);
+            break;
+        case json_reader::RequestType::BUS:
+            WriteBus(request, output);
+            break;
+        case json_reader::RequestType::MAP:
+            WriteMap(request, output);
+            break;
+        case json_reader::RequestType::ROUTE:
+            WriteRoute(request, output);
+            break;
+        default:
+            binary_protocol::ResponseWriter(output, request.id, binary_protocol::Status::BAD_REQUEST).End();
+            break;
+        }
+    }
+
+    void RequestHandler::AnswerRequest(const json_reader::StatRequest& request, json::Writer& writer) const {
+        switch (request.type) {
+        case json_reader::RequestType::STOP:
+            PrintStop(request, writer);
+            break;
+        case json_reader::RequestType::BUS:
+            PrintBus(request, writer);
+            break;
+        case json_reader::RequestType::MAP:
+            PrintMap(request, writer);
+            break;
+        case json_reader::RequestType::ROUTE:
+            PrintRoute(request, writer);
+            break;
+        default:
+            break;
+        }
+    }
+
+    void RequestHandler::PrintRequestsParallel(const std::vector<json_reader::StatRequest>& requests, json::Writer& writer) const {
+        const size_t chunk_count = (requests.size() + CHUNK_SIZE - 1) / CHUNK_SIZE;
+        const int indent = writer.Indent();
+
+        std::vector<AnswerChunk> chunks(chunk_count);
+        std::atomic<size_t> next_chunk = 0;
+        std::mutex mutex;
+        std::condition_variable chunk_ready;
+
+        auto process_chunks = [&] {
+            std::ostringstream out;
+            for (size_t index = next_chunk++; index < chunk_count; index = next_chunk++) {
+                std::vector<std::string> answers;
+                std::exception_ptr error;
+                try {
+                    const size_t end = std::min(requests.size(), (index + 1) * CHUNK_SIZE);
+                    for (size_t i = index * CHUNK_SIZE; i < end; ++i) {
+                        out.str({});
+                        json::Writer answer_writer(out, indent);
+                        PrintRequest(requests[i], answer_writer);
+                        answers.push_back(out.str());
+                    }
+                }
+                catch (...) {
+                    error = std::current_exception();
+                }
+                {
+                    std::lock_guard lock(mutex);
+                    chunks[index].answers = std::move(answers);
+                    chunks[index].error = error;
+                    chunks[index].ready = true;
+                }
+                chunk_ready.notify_all();
             }
+            };
 
-            if (type == "Route") {
-                requests.emplace_back(PrintRoute(request_map).AsMap()); //TODO
+        // Потоки объявлены после данных, которыми пользуются, и присоединяются первыми,
+        // в том числе при выходе по исключению
+        std::vector<std::jthread> workers;
+        workers.reserve(std::min(options_.thread_count, chunk_count));
+        for (size_t i = 0; i < std::min(options_.thread_count, chunk_count); ++i) {
+            workers.emplace_back(process_chunks);
+        }
+
+        // Готовые блоки выводятся по порядку, не дожидаясь обработки остальных
+        for (AnswerChunk& chunk : chunks) {
+            {
+                std::unique_lock lock(mutex);
+                chunk_ready.wait(lock, [&chunk] {
+                    return chunk.ready;
+                    });
+            }
+            if (chunk.error) {
+                next_chunk = chunk_count;
+                std::rethrow_exception(chunk.error);
             }
+            for (const std::string& answer : chunk.answers) {
+                // На запрос неизвестного типа ответа нет, как и при обработке на одном потоке
+                if (!answer.empty()) {
+                    writer.RawValue(answer);
+                }
+            }
+            chunk.answers = {};
         }
-        json::Print(json::Document(requests), std::cout);
     }
 
     svg::Document RequestHandler::RenderMap() const
@@ -58,124 +294,235 @@ namespace request_handler
         return renderer_.GetSVGDocument(sorted_buses);
     }
 
-    const json::Node RequestHandler::PrintBus(const json::Dict& bus_request) const {
-        auto result = json::Builder{};
-        result.StartDict();
-        const std::string& bus_name = bus_request.at("name").AsString();
-        const int id = bus_request.at("id").AsInt();
+    void RequestHandler::PrintBus(const json_reader::StatRequest& bus_request, json::Writer& writer) const {
+        const std::string_view bus_name = bus_request.name;
+        const int id = bus_request.id;
+        writer.StartDict();
         if (!db_.FindBus(bus_name)) {
-            result.Key("request_id").Value(id)
-                .Key("error_message").Value((std::string)"not found");
+            writer.Key("error_message").Value("not found")
+                .Key("request_id").Value(id);
         }
         else {
             auto busInfo = GetBusStat(bus_name);
-            result.Key("request_id").Value(id)
-                .Key("stop_count").Value(busInfo->numStops)
+            writer.Key("curvature").Value(busInfo->curvature)
+                .Key("request_id").Value(id)
                 .Key("route_length").Value(busInfo->routeLength)
-                .Key("unique_stop_count").Value(busInfo->numUniqueStops)
-                .Key("curvature").Value(busInfo->curvature);
+                .Key("stop_count").Value(busInfo->numStops)
+                .Key("unique_stop_count").Value(busInfo->numUniqueStops);
         }
-        result.EndDict();
-        return result.Build();
+        writer.EndDict();
     }
 
-    const json::Node RequestHandler::PrintStop(const json::Dict& stop_request) const {
-        auto result = json::Builder{};
-        result.StartDict();
-        const std::string& stop_name = stop_request.at("name").AsString();
-        const int id = stop_request.at("id").AsInt();
+    void RequestHandler::PrintStop(const json_reader::StatRequest& stop_request, json::Writer& writer) const {
+        const std::string_view stop_name = stop_request.name;
+        const int id = stop_request.id;
 
+        writer.StartDict();
         const auto stop = db_.FindStop(stop_name);
         if (!stop) {
-            result.Key("request_id").Value(id)
-                .Key("error_message").Value((std::string)"not found");
+            writer.Key("error_message").Value("not found")
+                .Key("request_id").Value(id);
         }
         else
         {
-            json::Array buses;
+            writer.Key("buses").StartArray();
             for (auto& bus : GetBusesByStop(stop_name)) {
-                buses.emplace_back((std::string)bus);
+                writer.Value(bus);
             }
-            result.Key("request_id").Value(id)
-                .Key("buses").Value(buses);
+            writer.EndArray()
+                .Key("request_id").Value(id);
         }
-        result.EndDict();
-        return result.Build();
+        writer.EndDict();
     }
 
 
-    const json::Node RequestHandler::PrintMap(const json::Dict& map_request) const
+    std::shared_ptr<const RequestHandler::RenderedMap> RequestHandler::GetRenderedMap() const
     {
-        std::ostringstream strm;
-        auto mapRequest = RenderMap();
-        mapRequest.Render(strm);
-        const int id = map_request.at("id").AsInt();
+        // Мьютекс удерживается на время отрисовки, чтобы параллельные запросы Map
+        // не строили одну и ту же карту одновременно
+        std::lock_guard lock(map_cache_mutex_);
+        const uint64_t version = db_.GetVersion();
+        if (map_cache_.version != version) {
+            map_cache_ = { version, nullptr, nullptr };
+        }
+        if (!map_cache_.map) {
+            TRACE_SCOPE("RequestHandler::RenderMap");
+            std::ostringstream svg;
+            renderer_.RenderSVG(db_.GetSortedBuses(), svg, options_.thread_count);
+            std::ostringstream json;
+            json::Writer(json).Value(svg.str());
+            map_cache_.map = std::make_shared<const RenderedMap>(RenderedMap{ svg.str(), json.str() });
+        }
+        return map_cache_.map;
+    }
 
-        auto result = json::Builder{};
-        result.StartDict();
-        result.Key("request_id").Value(id)
-            .Key("map").Value(strm.str());
+    std::shared_ptr<const renderer::MapIndex> RequestHandler::GetMapIndex() const
+    {
+        std::lock_guard lock(map_cache_mutex_);
+        const uint64_t version = db_.GetVersion();
+        if (map_cache_.version != version) {
+            map_cache_ = { version, nullptr, nullptr };
+        }
+        if (!map_cache_.index) {
+            TRACE_SCOPE("RequestHandler::BuildMapIndex");
+            map_cache_.index = std::make_shared<const renderer::MapIndex>(db_.GetSortedBuses());
+        }
+        return map_cache_.index;
+    }
 
-        result.EndDict();
-        return result.Build();
+    std::optional<std::string> RequestHandler::RenderMapArea(const renderer::MapArea& area) const
+    {
+        const auto index = GetMapIndex();
+        std::optional<renderer::GeoRect> region;
+        if (const auto* rect = std::get_if<renderer::GeoRect>(&area)) {
+            region = *rect;
+        }
+        else if (const auto* tile = std::get_if<renderer::Tile>(&area)) {
+            region = index->GetTileRect(*tile);
+        }
+        if (!region) {
+            return std::nullopt;
+        }
+        std::ostringstream svg;
+        renderer_.RenderRegionSVG(*index, *region, svg);
+        return svg.str();
+    }
+
+    void RequestHandler::PrintMap(const json_reader::StatRequest& map_request, json::Writer& writer) const
+    {
+        writer.StartDict();
+        if (std::holds_alternative<std::monostate>(map_request.area)) {
+            const auto map = GetRenderedMap();
+            writer.Key("map").RawValue(map->json);
+        }
+        else if (const auto svg = RenderMapArea(map_request.area)) {
+            writer.Key("map").Value(*svg);
+        }
+        else {
+            writer.Key("error_message").Value("not found");
+        }
+        writer.Key("request_id").Value(map_request.id)
+            .EndDict();
     }
 
-    const json::Node RequestHandler::PrintRoute(const json::Dict& route_request) const {
-        json::Node result;
-        const int id = route_request.at("id").AsInt();
-        const std::string_view stop_from = route_request.at("from").AsString();
-        const std::string_view stop_to = route_request.at("to").AsString();
+    void RequestHandler::PrintRoute(const json_reader::StatRequest& route_request, json::Writer& writer) const {
+        const int id = route_request.id;
+        const std::string_view stop_from = route_request.from;
+        const std::string_view stop_to = route_request.to;
         const auto& routing = router_.FindRoute(stop_from, stop_to);
 
+        writer.StartDict();
         if (!routing) {
-            result = json::Builder{}
-                .StartDict()
-                .Key("request_id").Value(id)
-                .Key("error_message").Value((std::string)"not found")
-                .EndDict()
-                .Build();
+            writer.Key("error_message").Value("not found")
+                .Key("request_id").Value(id);
         }
         else {
-            json::Array items;
             double total_time = 0.0;
-            items.reserve(routing.value().edges.size());
+            writer.Key("items").StartArray();
             for (auto& edge_id : routing.value().edges) {
-                const graph::Edge<double> edge = router_.GetGraph().GetEdge(edge_id);
+                const graph::Edge<double>& edge = router_.GetGraph().GetEdge(edge_id);
                 if (edge.quality == 0) {
-                    items.emplace_back(json::Node(json::Builder{}
-                        .StartDict()
+                    writer.StartDict()
                         .Key("stop_name").Value(edge.name)
                         .Key("time").Value(edge.weight)
-                        .Key("type").Value((std::string)"Wait")
-                        .EndDict()
-                        .Build()));
-
-                    total_time += edge.weight;
+                        .Key("type").Value("Wait")
+                        .EndDict();
                 }
                 else {
-                    items.emplace_back(json::Node(json::Builder{}
-                        .StartDict()
+                    writer.StartDict()
                         .Key("bus").Value(edge.name)
                         .Key("span_count").Value(static_cast<int>(edge.quality))
                         .Key("time").Value(edge.weight)
-                        .Key("type").Value((std::string)"Bus")
-                        .EndDict()
-                        .Build()));
-
-                    total_time += edge.weight;
+                        .Key("type").Value("Bus")
+                        .EndDict();
                 }
+                total_time += edge.weight;
             }
-
-            result = json::Builder{}
-                .StartDict()
+            writer.EndArray()
                 .Key("request_id").Value(id)
-                .Key("total_time").Value(total_time)
-                .Key("items").Value(items)
-                .EndDict()
-                .Build();
+                .Key("total_time").Value(total_time);
         }
+        writer.EndDict();
+    }
 
-        return result;
+    void RequestHandler::WriteBus(const binary_protocol::Request& bus_request, std::string& output) const {
+        const auto bus = db_.GetBus(bus_request.object);
+        if (!bus) {
+            binary_protocol::ResponseWriter(output, bus_request.id, binary_protocol::Status::NOT_FOUND).End();
+            return;
+        }
+        const auto bus_info = db_.GetBusInfo(bus->name);
+        binary_protocol::ResponseWriter(output, bus_request.id, binary_protocol::Status::OK)
+            .Double(bus_info.curvature)
+            .Double(bus_info.routeLength)
+            .UInt32(static_cast<uint32_t>(bus_info.numStops))
+            .UInt32(static_cast<uint32_t>(bus_info.numUniqueStops))
+            .End();
+    }
+
+    void RequestHandler::WriteStop(const binary_protocol::Request& stop_request, std::string& output) const {
+        const auto stop = db_.GetStop(stop_request.object);
+        if (!stop) {
+            binary_protocol::ResponseWriter(output, stop_request.id, binary_protocol::Status::NOT_FOUND).End();
+            return;
+        }
+        const auto buses = db_.GetBusesOnStop(*stop);
+        binary_protocol::ResponseWriter writer(output, stop_request.id, binary_protocol::Status::OK);
+        writer.UInt32(static_cast<uint32_t>(buses.size()));
+        for (const std::string_view bus : buses) {
+            writer.UInt32(BusId(db_, bus));
+        }
+        writer.End();
+    }
+
+    void RequestHandler::WriteMap(const binary_protocol::Request& map_request, std::string& output) const {
+        if (std::holds_alternative<std::monostate>(map_request.area)) {
+            const auto map = GetRenderedMap();
+            binary_protocol::ResponseWriter(output, map_request.id, binary_protocol::Status::OK)
+                .Bytes(map->svg)
+                .End();
+        }
+        else if (const auto svg = RenderMapArea(map_request.area)) {
+            binary_protocol::ResponseWriter(output, map_request.id, binary_protocol::Status::OK)
+                .Bytes(*svg)
+                .End();
+        }
+        else {
+            binary_protocol::ResponseWriter(output, map_request.id, binary_protocol::Status::NOT_FOUND).End();
+        }
+    }
+
+    void RequestHandler::WriteRoute(const binary_protocol::Request& route_request, std::string& output) const {
+        const auto stop_from = db_.GetStop(route_request.object);
+        const auto stop_to = db_.GetStop(route_request.to);
+        const auto routing = stop_from && stop_to ? router_.FindRoute(stop_from->name, stop_to->name) : std::nullopt;
+        if (!routing) {
+            binary_protocol::ResponseWriter(output, route_request.id, binary_protocol::Status::NOT_FOUND).End();
+            return;
+        }
+
+        double total_time = 0.0;
+        for (auto& edge_id : routing->edges) {
+            total_time += router_.GetGraph().GetEdge(edge_id).weight;
+        }
+        binary_protocol::ResponseWriter writer(output, route_request.id, binary_protocol::Status::OK);
+        writer.Double(total_time)
+            .UInt32(static_cast<uint32_t>(routing->edges.size()));
+        for (auto& edge_id : routing->edges) {
+            const graph::Edge<double>& edge = router_.GetGraph().GetEdge(edge_id);
+            if (edge.quality == 0) {
+                writer.UInt8(static_cast<uint8_t>(binary_protocol::RouteItemType::WAIT))
+                    .UInt32(StopId(db_, edge.name))
+                    .Double(edge.weight);
+            }
+            else {
+                writer.UInt8(static_cast<uint8_t>(binary_protocol::RouteItemType::BUS))
+                    .UInt32(BusId(db_, edge.name))
+                    .UInt32(static_cast<uint32_t>(edge.quality))
+                    .Double(edge.weight);
+            }
+        }
+        writer.End();
     }
 
 }
\ No newline at end of file
@@ -1,24 +1,53 @@
 #pragma once
 
+#include <cstdint>
+#include <iostream>
+#include <memory>
+#include <mutex>
 #include <set>
 #include <optional>
+#include <string>
 #include <string_view>
+#include <vector>
 
 
 #include "transport_catalogue.h"
 #include "domain.h"
 #include "map_renderer.h"
 #include "json_reader.h"
+#include "binary_protocol.h"
+#include "request_capture.h"
+#include "request_stats.h"
 #include "svg.h"
 #include "transport_router.h"
 
 
 namespace request_handler
 {
+    enum class Protocol {
+        JSON,
+        // binary_protocol: кадры с номерами остановок и маршрутов вместо текста
+        BINARY,
+    };
+
+    struct HandlerOptions {
+        // Больше 1 - параллельная обработка stat_requests
+        size_t thread_count = 1;
+        // Если задан, в него записывается время обработки каждого запроса
+        RequestStats* stats = nullptr;
+        // Если задан, в него записывается каждый обработанный запрос
+        RequestCapture* capture = nullptr;
+        // Формат ответов на stat_requests входного документа
+        Protocol protocol = Protocol::JSON;
+        // Куда выводятся ответы на stat_requests входного документа
+        std::ostream* output = &std::cout;
+    };
+
     class RequestHandler {
     public:
-        RequestHandler(const transport_catalogue::TransportCatalogue& db, const renderer::MapRenderer& renderer, const json_reader::JsonReader reader, const transport_catalogue::Router& router)
-            : db_(db), renderer_(renderer), reader_(reader), router_(router)
+        RequestHandler(const transport_catalogue::TransportCatalogue& db, const renderer::MapRenderer& renderer, const json_reader::JsonReader& reader, const transport_catalogue::Router& router,
+            const HandlerOptions& options = {})
+            : db_(db), renderer_(renderer), reader_(reader), router_(router), options_(options)
         {
             PrintRequests();
         }
@@ -31,20 +60,94 @@ namespace request_handler
 
         void PrintRequests() const;
 
+        // Записывает в output массив ответов на requests
+        void PrintRequests(const std::vector<json_reader::StatRequest>& requests, std::ostream& output) const;
+
+        // Записывает ответ на один запрос
+        void PrintRequest(const json_reader::StatRequest& request, json::Writer& writer) const;
+
+        // Как PrintRequest, но без записи в статистику и RequestCapture из HandlerOptions:
+        // так повтор записанных запросов не смешивается с обработкой исходных
+        void ReplayRequest(const json_reader::StatRequest& request, json::Writer& writer) const;
+
+        // Дописывает в output кадр ответа на запрос двоичного протокола
+        void WriteAnswer(const binary_protocol::Request& request, std::string& output) const;
+
+        Protocol GetProtocol() const {
+            return options_.protocol;
+        }
+
         // Этот метод будет нужен в следующей части итогового проекта
         svg::Document RenderMap() const;
 
     private:
-        const json::Node PrintBus(const json::Dict& bus_request) const;
-        const json::Node PrintStop(const json::Dict& stop_request) const;
-        const json::Node PrintMap(const json::Dict& map_request) const;
-        const json::Node PrintRoute(const json::Dict& route_request) const;
+        // Выполняет answer и записывает время его работы, если ведётся статистика
+        template <typename Answer>
+        void Measure(json_reader::RequestType type, Answer&& answer) const {
+            // Без статистики часы не опрашиваются
+            if (!options_.stats) {
+                answer();
+                return;
+            }
+            const auto start = RequestStats::Clock::now();
+            answer();
+            options_.stats->RecordRequest(type, RequestStats::Clock::now() - start);
+        }
+
+        void AnswerRequest(const json_reader::StatRequest& request, json::Writer& writer) const;
+
+        // Запросы только читают справочник и маршрутизатор, поэтому обрабатываются на
+        // options_.thread_count потоках. Ответы собираются и выводятся в исходном порядке
+        void PrintRequestsParallel(const std::vector<json_reader::StatRequest>& requests, json::Writer& writer) const;
+
+        // Отвечает на запросы в формате binary_protocol. Названия из запросов
+        // заменяются номерами, неизвестное название даёт ответ Status::NOT_FOUND
+        void WriteRequests(const std::vector<json_reader::StatRequest>& requests, std::ostream& output) const;
+        void WriteAnswerTo(const binary_protocol::Request& request, std::string& output) const;
+
+        struct RenderedMap {
+            std::string svg;
+            // svg в виде строкового литерала JSON
+            std::string json;
+        };
+
+        // Карта зависит только от справочника и настроек отрисовки, поэтому строится
+        // один раз для каждой версии справочника
+        std::shared_ptr<const RenderedMap> GetRenderedMap() const;
+
+        // Индекс для отрисовки частей карты строится при первом таком запросе
+        // и хранится вместе с картой
+        std::shared_ptr<const renderer::MapIndex> GetMapIndex() const;
+
+        // SVG части карты или std::nullopt для несуществующего тайла. Части карты не кэшируются
+        std::optional<std::string> RenderMapArea(const renderer::MapArea& area) const;
+
+        // Ответы записываются сразу в writer. Ключи идут по алфавиту,
+        // в том же порядке, в каком их выводит json::Print
+        void PrintBus(const json_reader::StatRequest& bus_request, json::Writer& writer) const;
+        void PrintStop(const json_reader::StatRequest& stop_request, json::Writer& writer) const;
+        void PrintMap(const json_reader::StatRequest& map_request, json::Writer& writer) const;
+        void PrintRoute(const json_reader::StatRequest& route_request, json::Writer& writer) const;
+
+        void WriteBus(const binary_protocol::Request& bus_request, std::string& output) const;
+        void WriteStop(const binary_protocol::Request& stop_request, std::string& output) const;
+        void WriteMap(const binary_protocol::Request& map_request, std::string& output) const;
+        void WriteRoute(const binary_protocol::Request& route_request, std::string& output) const;
 
     private:
         const transport_catalogue::TransportCatalogue& db_;
         const renderer::MapRenderer& renderer_;
-        const json_reader::JsonReader reader_;
+        const json_reader::JsonReader& reader_;
         const transport_catalogue::Router& router_;
+        const HandlerOptions options_;
+
+        struct MapCache {
+            uint64_t version = 0;
+            std::shared_ptr<const RenderedMap> map;
+            std::shared_ptr<const renderer::MapIndex> index;
+        };
+        mutable std::mutex map_cache_mutex_;
+        mutable MapCache map_cache_;
     };
 }
 
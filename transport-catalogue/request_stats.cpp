@@ -0,0 +1,118 @@
+#include "request_stats.h"
+
+#include <algorithm>
+#include <bit>
+#include <cmath>
+#include <iomanip>
+
+namespace request_handler {
+
+    using namespace std::literals;
+
+    size_t LatencyHistogram::BucketIndex(uint64_t value) {
+        if (value < SUB_BUCKET_COUNT) {
+            return static_cast<size_t>(value);
+        }
+        // Для value из [2^k, 2^(k+1)) старшие SUB_BUCKET_BITS + 1 бит задают корзину внутри интервала
+        const int shift = std::bit_width(value) - 1 - SUB_BUCKET_BITS;
+        const size_t sub_bucket = static_cast<size_t>(value >> shift) - SUB_BUCKET_COUNT;
+        return (static_cast<size_t>(shift) + 1) * SUB_BUCKET_COUNT + sub_bucket;
+    }
+
+    uint64_t LatencyHistogram::BucketUpperBound(size_t index) {
+        if (index < SUB_BUCKET_COUNT) {
+            return index;
+        }
+        const size_t shift = index / SUB_BUCKET_COUNT - 1;
+        const uint64_t sub_bucket = index % SUB_BUCKET_COUNT + SUB_BUCKET_COUNT;
+        return ((sub_bucket + 1) << shift) - 1;
+    }
+
+    void LatencyHistogram::Record(uint64_t nanoseconds) {
+        buckets_[BucketIndex(nanoseconds)].fetch_add(1, std::memory_order_relaxed);
+        count_.fetch_add(1, std::memory_order_relaxed);
+        total_.fetch_add(nanoseconds, std::memory_order_relaxed);
+        uint64_t max = max_.load(std::memory_order_relaxed);
+        while (nanoseconds > max && !max_.compare_exchange_weak(max, nanoseconds, std::memory_order_relaxed)) {
+        }
+    }
+
+    uint64_t LatencyHistogram::Count() const {
+        return count_.load(std::memory_order_relaxed);
+    }
+
+    uint64_t LatencyHistogram::Total() const {
+        return total_.load(std::memory_order_relaxed);
+    }
+
+    uint64_t LatencyHistogram::Max() const {
+        return max_.load(std::memory_order_relaxed);
+    }
+
+    uint64_t LatencyHistogram::Percentile(double percentile) const {
+        const uint64_t count = Count();
+        if (count == 0) {
+            return 0;
+        }
+        const auto rank = std::max<uint64_t>(1, static_cast<uint64_t>(std::ceil(percentile / 100.0 * count)));
+        uint64_t seen = 0;
+        for (size_t index = 0; index < BUCKET_COUNT; ++index) {
+            seen += buckets_[index].load(std::memory_order_relaxed);
+            if (seen >= rank) {
+                return std::min(BucketUpperBound(index), Max());
+            }
+        }
+        return Max();
+    }
+
+    void RequestStats::RecordRequest(json_reader::RequestType type, Clock::duration latency) {
+        const auto nanoseconds = std::chrono::duration_cast<std::chrono::nanoseconds>(latency).count();
+        latencies_[static_cast<size_t>(type)].Record(static_cast<uint64_t>(std::max<int64_t>(nanoseconds, 0)));
+    }
+
+    void RequestStats::RecordBatch(size_t request_count, Clock::duration duration) {
+        const auto nanoseconds = std::chrono::duration_cast<std::chrono::nanoseconds>(duration).count();
+        batch_requests_.fetch_add(request_count, std::memory_order_relaxed);
+        batch_nanoseconds_.fetch_add(static_cast<uint64_t>(std::max<int64_t>(nanoseconds, 0)), std::memory_order_relaxed);
+    }
+
+    void RequestStats::Print(std::ostream& output) const {
+        auto microseconds = [](uint64_t nanoseconds) {
+            return static_cast<double>(nanoseconds) / 1000.0;
+        };
+
+        const auto flags = output.flags();
+        const auto precision = output.precision();
+        output << std::fixed << std::setprecision(1);
+        output << std::left << std::setw(8) << "type"sv << std::right
+            << std::setw(10) << "count"sv << std::setw(12) << "total_us"sv << std::setw(10) << "mean_us"sv
+            << std::setw(10) << "p50_us"sv << std::setw(10) << "p90_us"sv << std::setw(10) << "p99_us"sv
+            << std::setw(10) << "p99.9_us"sv << std::setw(10) << "max_us"sv << '\n';
+        for (size_t type = 0; type < TYPE_COUNT; ++type) {
+            const LatencyHistogram& latency = latencies_[type];
+            const uint64_t count = latency.Count();
+            if (count == 0) {
+                continue;
+            }
+            output << std::left << std::setw(8) << json_reader::RequestTypeName(static_cast<json_reader::RequestType>(type)) << std::right
+                << std::setw(10) << count
+                << std::setw(12) << microseconds(latency.Total())
+                << std::setw(10) << microseconds(latency.Total()) / static_cast<double>(count)
+                << std::setw(10) << microseconds(latency.Percentile(50.0))
+                << std::setw(10) << microseconds(latency.Percentile(90.0))
+                << std::setw(10) << microseconds(latency.Percentile(99.0))
+                << std::setw(10) << microseconds(latency.Percentile(99.9))
+                << std::setw(10) << microseconds(latency.Max()) << '\n';
+        }
+
+        const uint64_t requests = batch_requests_.load(std::memory_order_relaxed);
+        const uint64_t nanoseconds = batch_nanoseconds_.load(std::memory_order_relaxed);
+        if (nanoseconds > 0) {
+            output << "throughput: "sv << requests << " requests in "sv << microseconds(nanoseconds) / 1000.0
+                << " ms, "sv << static_cast<double>(requests) * 1e9 / static_cast<double>(nanoseconds) << " requests/s\n"sv;
+        }
+        output.flags(flags);
+        output.precision(precision);
+    }
+
+}  // namespace request_handler
@@ -0,0 +1,61 @@
+#pragma once
+
+#include "json_reader.h"
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <iostream>
+
+namespace request_handler {
+
+    // Гистограмма задержек с логарифмически-линейными корзинами, как в HdrHistogram:
+    // каждый интервал [2^k, 2^(k+1)) делится на SUB_BUCKET_COUNT равных корзин, поэтому
+    // относительная погрешность процентилей не превышает 1/SUB_BUCKET_COUNT.
+    // Запись не блокирует и может идти из нескольких потоков одновременно
+    class LatencyHistogram {
+    public:
+        void Record(uint64_t nanoseconds);
+
+        uint64_t Count() const;
+        uint64_t Total() const;
+        uint64_t Max() const;
+        // Значение, не меньше которого percentile процентов записанных значений
+        uint64_t Percentile(double percentile) const;
+
+    private:
+        static constexpr int SUB_BUCKET_BITS = 5;
+        static constexpr size_t SUB_BUCKET_COUNT = size_t{ 1 } << SUB_BUCKET_BITS;
+        static constexpr size_t BUCKET_COUNT = (64 - SUB_BUCKET_BITS + 1) * SUB_BUCKET_COUNT;
+
+        static size_t BucketIndex(uint64_t value);
+        static uint64_t BucketUpperBound(size_t index);
+
+        std::array<std::atomic<uint64_t>, BUCKET_COUNT> buckets_{};
+        std::atomic<uint64_t> count_ = 0;
+        std::atomic<uint64_t> total_ = 0;
+        std::atomic<uint64_t> max_ = 0;
+    };
+
+    // Число и время обработки запросов каждого типа и пропускная способность пакетов.
+    // RequestHandler собирает статистику, только если она ему передана
+    class RequestStats {
+    public:
+        using Clock = std::chrono::steady_clock;
+
+        void RecordRequest(json_reader::RequestType type, Clock::duration latency);
+        void RecordBatch(size_t request_count, Clock::duration duration);
+
+        // Таблица по типам запросов, времена в микросекундах
+        void Print(std::ostream& output) const;
+
+    private:
+        static constexpr size_t TYPE_COUNT = static_cast<size_t>(json_reader::RequestType::ROUTE) + 1;
+
+        std::array<LatencyHistogram, TYPE_COUNT> latencies_;
+        std::atomic<uint64_t> batch_requests_ = 0;
+        std::atomic<uint64_t> batch_nanoseconds_ = 0;
+    };
+
+}  // namespace request_handler
@@ -0,0 +1,390 @@
+#include "server.h"
+
+#include <stdexcept>
+#include <utility>
+
+#ifdef __linux__
+#include <cctype>
+#include <cerrno>
+#include <csignal>
+#include <cstring>
+#include <iostream>
+#include <sstream>
+#include <system_error>
+#include <unordered_map>
+
+#include <sys/epoll.h>
+#include <sys/signalfd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#endif
+
+namespace server {
+
+    Server::Server(const request_handler::RequestHandler& handler, std::string socket_path, size_t max_document_size)
+        : handler_(handler)
+        , socket_path_(std::move(socket_path))
+        , max_document_size_(max_document_size) {
+    }
+
+#ifdef __linux__
+
+    namespace {
+        using namespace std::literals;
+
+        constexpr int MAX_EVENTS = 64;
+        constexpr size_t READ_BLOCK_SIZE = 64 * 1024;
+
+        [[noreturn]] void ThrowSystemError(const char* what) {
+            throw std::system_error(errno, std::generic_category(), what);
+        }
+
+        // Владеет файловым дескриптором и закрывает его в деструкторе
+        class FileDescriptor {
+        public:
+            explicit FileDescriptor(int fd = -1)
+                : fd_(fd) {
+            }
+            FileDescriptor(FileDescriptor&& other) noexcept
+                : fd_(std::exchange(other.fd_, -1)) {
+            }
+            FileDescriptor& operator=(FileDescriptor&& other) noexcept {
+                std::swap(fd_, other.fd_);
+                return *this;
+            }
+            ~FileDescriptor() {
+                if (fd_ != -1) {
+                    close(fd_);
+                }
+            }
+
+            int Get() const {
+                return fd_;
+            }
+
+        private:
+            int fd_;
+        };
+
+        // Состояние клиента: непрочитанный хвост входных данных и неотправленные ответы.
+        // Границы документов находятся по балансу скобок вне строковых литералов,
+        // поэтому документы можно отправлять без дополнительного кадрирования
+        struct Connection {
+            FileDescriptor fd;
+            std::string input;
+            size_t scanned = 0;
+            int depth = 0;
+            bool in_string = false;
+            bool escaped = false;
+            std::string output;
+            size_t written = 0;
+            bool closing = false;
+
+            // Возвращает длину первого полного документа во входных данных или 0,
+            // если документ ещё не получен целиком. Лишняя закрывающая скобка и документ
+            // длиннее max_size приводят к исключению
+            size_t FindDocumentEnd(size_t max_size) {
+                for (; scanned < input.size(); ++scanned) {
+                    if (scanned >= max_size) {
+                        throw std::length_error("Document is too long"s);
+                    }
+                    const char c = input[scanned];
+                    if (in_string) {
+                        if (escaped) {
+                            escaped = false;
+                        }
+                        else if (c == '\\') {
+                            escaped = true;
+                        }
+                        else if (c == '"') {
+                            in_string = false;
+                        }
+                    }
+                    else if (c == '"') {
+                        in_string = true;
+                    }
+                    else if (c == '{' || c == '[') {
+                        ++depth;
+                    }
+                    else if (c == '}' || c == ']') {
+                        if (depth == 0) {
+                            throw json::ParsingError("Unexpected closing bracket"s);
+                        }
+                        if (--depth == 0) {
+                            return ++scanned;
+                        }
+                    }
+                    else if (depth == 0 && !std::isspace(static_cast<unsigned char>(c))) {
+                        throw json::ParsingError("Array or dictionary is expected"s);
+                    }
+                }
+                return 0;
+            }
+
+            // Удаляет из входных данных обработанный документ или кадр
+            void ConsumeDocument(size_t length) {
+                input.erase(0, length);
+                scanned = 0;
+            }
+        };
+
+        void AddToEpoll(int epoll_fd, int fd, uint32_t events) {
+            epoll_event event{};
+            event.events = events;
+            event.data.fd = fd;
+            if (epoll_ctl(epoll_fd, EPOLL_CTL_ADD, fd, &event) == -1) {
+                ThrowSystemError("epoll_ctl");
+            }
+        }
+
+        void ModifyEpoll(int epoll_fd, int fd, uint32_t events) {
+            epoll_event event{};
+            event.events = events;
+            event.data.fd = fd;
+            if (epoll_ctl(epoll_fd, EPOLL_CTL_MOD, fd, &event) == -1) {
+                ThrowSystemError("epoll_ctl");
+            }
+        }
+
+        FileDescriptor Listen(const std::string& socket_path) {
+            sockaddr_un address{};
+            address.sun_family = AF_UNIX;
+            if (socket_path.size() >= sizeof(address.sun_path)) {
+                throw std::invalid_argument("Socket path is too long: "s + socket_path);
+            }
+            std::memcpy(address.sun_path, socket_path.c_str(), socket_path.size() + 1);
+
+            FileDescriptor listener(socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0));
+            if (listener.Get() == -1) {
+                ThrowSystemError("socket");
+            }
+            // Файл сокета мог остаться от предыдущего запуска
+            unlink(socket_path.c_str());
+            if (bind(listener.Get(), reinterpret_cast<const sockaddr*>(&address), sizeof(address)) == -1) {
+                ThrowSystemError("bind");
+            }
+            if (listen(listener.Get(), SOMAXCONN) == -1) {
+                ThrowSystemError("listen");
+            }
+            return listener;
+        }
+
+        // SIGINT и SIGTERM доставляются через signalfd, чтобы цикл обработки событий
+        // завершился штатно и удалил файл сокета
+        FileDescriptor BlockStopSignals() {
+            sigset_t signals;
+            sigemptyset(&signals);
+            sigaddset(&signals, SIGINT);
+            sigaddset(&signals, SIGTERM);
+            if (sigprocmask(SIG_BLOCK, &signals, nullptr) == -1) {
+                ThrowSystemError("sigprocmask");
+            }
+            FileDescriptor signal_fd(signalfd(-1, &signals, SFD_NONBLOCK | SFD_CLOEXEC));
+            if (signal_fd.Get() == -1) {
+                ThrowSystemError("signalfd");
+            }
+            return signal_fd;
+        }
+
+        // Отправляет накопленные ответы. Возвращает false, если сокет переполнен
+        bool Flush(Connection& connection) {
+            while (connection.written < connection.output.size()) {
+                const ssize_t sent = send(connection.fd.Get(), connection.output.data() + connection.written,
+                    connection.output.size() - connection.written, MSG_NOSIGNAL);
+                if (sent == -1) {
+                    if (errno == EAGAIN || errno == EWOULDBLOCK) {
+                        return false;
+                    }
+                    if (errno == EINTR) {
+                        continue;
+                    }
+                    // Клиент отключился, не дождавшись ответа
+                    connection.closing = true;
+                    connection.output.clear();
+                    connection.written = 0;
+                    return true;
+                }
+                connection.written += static_cast<size_t>(sent);
+            }
+            connection.output.clear();
+            connection.written = 0;
+            return true;
+        }
+    }  // namespace
+
+    void Server::Run() {
+        FileDescriptor signal_fd = BlockStopSignals();
+        FileDescriptor listener = Listen(socket_path_);
+        FileDescriptor epoll_fd(epoll_create1(EPOLL_CLOEXEC));
+        if (epoll_fd.Get() == -1) {
+            ThrowSystemError("epoll_create1");
+        }
+        AddToEpoll(epoll_fd.Get(), listener.Get(), EPOLLIN);
+        AddToEpoll(epoll_fd.Get(), signal_fd.Get(), EPOLLIN);
+
+        std::unordered_map<int, Connection> connections;
+        std::ostringstream answer;
+        std::string block(READ_BLOCK_SIZE, '\0');
+
+        // Отвечает на все полученные целиком документы клиента
+        auto answer_documents = [this, &answer](Connection& connection) {
+            try {
+                while (const size_t length = connection.FindDocumentEnd(max_document_size_)) {
+                    const json::Document document = json::Load(std::string_view(connection.input).substr(0, length));
+                    const json::Node& root = document.GetRoot();
+                    const auto requests = json_reader::ReadStatRequests(root);
+                    connection.ConsumeDocument(length);
+
+                    answer.str({});
+                    if (root.IsArray()) {
+                        handler_.PrintRequests(requests, answer);
+                    }
+                    else if (requests.front().type == json_reader::RequestType::UNKNOWN) {
+                        // В массиве такие запросы пропускаются, но на отдельный документ
+                        // клиент должен получить хоть какой-то ответ
+                        json::Writer(answer).StartDict()
+                            .Key("error_message").Value("unknown request type")
+                            .Key("request_id").Value(requests.front().id)
+                            .EndDict();
+                    }
+                    else {
+                        json::Writer writer(answer);
+                        handler_.PrintRequest(requests.front(), writer);
+                    }
+                    answer.put('\n');
+                    connection.output += answer.str();
+                }
+            }
+            catch (const std::exception& e) {
+                // После ошибки границы следующих документов неизвестны, поэтому клиент
+                // получает сообщение об ошибке, и соединение закрывается
+                answer.str({});
+                json::Writer(answer).StartDict().Key("error_message").Value(e.what()).EndDict();
+                answer.put('\n');
+                connection.output += answer.str();
+                connection.closing = true;
+            }
+            };
+
+        // Отвечает на все полученные целиком кадры двоичного протокола
+        auto answer_frames = [this](Connection& connection) {
+            try {
+                while (const size_t length = binary_protocol::FindFrameEnd(connection.input, binary_protocol::MAX_REQUEST_SIZE)) {
+                    binary_protocol::Request request;
+                    const std::string_view payload = std::string_view(connection.input).substr(sizeof(uint32_t), length - sizeof(uint32_t));
+                    if (binary_protocol::DecodeRequest(payload, request)) {
+                        handler_.WriteAnswer(request, connection.output);
+                    }
+                    else {
+                        // Границы кадров известны, поэтому соединение можно не закрывать
+                        binary_protocol::ResponseWriter(connection.output, request.id, binary_protocol::Status::BAD_REQUEST).End();
+                    }
+                    connection.ConsumeDocument(length);
+                }
+            }
+            catch (const std::exception&) {
+                binary_protocol::ResponseWriter(connection.output, 0, binary_protocol::Status::BAD_REQUEST).End();
+                connection.closing = true;
+            }
+            };
+        const bool binary = handler_.GetProtocol() == request_handler::Protocol::BINARY;
+
+        bool stopped = false;
+        epoll_event events[MAX_EVENTS];
+        while (!stopped) {
+            const int event_count = epoll_wait(epoll_fd.Get(), events, MAX_EVENTS, -1);
+            if (event_count == -1) {
+                if (errno == EINTR) {
+                    continue;
+                }
+                ThrowSystemError("epoll_wait");
+            }
+
+            for (int i = 0; i < event_count; ++i) {
+                const int fd = events[i].data.fd;
+                if (fd == signal_fd.Get()) {
+                    stopped = true;
+                    continue;
+                }
+                if (fd == listener.Get()) {
+                    while (true) {
+                        FileDescriptor client(accept4(listener.Get(), nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC));
+                        if (client.Get() == -1) {
+                            if (errno == EAGAIN || errno == EWOULDBLOCK) {
+                                break;
+                            }
+                            if (errno == EINTR || errno == ECONNABORTED) {
+                                continue;
+                            }
+                            // Нехватка дескрипторов или памяти не должна останавливать сервер:
+                            // уже подключённые клиенты продолжают обслуживаться, а ожидающие
+                            // подключения будут приняты, когда ресурсы освободятся
+                            std::cerr << "accept4: "sv << std::strerror(errno) << std::endl;
+                            break;
+                        }
+                        const int client_fd = client.Get();
+                        AddToEpoll(epoll_fd.Get(), client_fd, EPOLLIN | EPOLLRDHUP);
+                        connections[client_fd].fd = std::move(client);
+                    }
+                    continue;
+                }
+
+                const auto it = connections.find(fd);
+                if (it == connections.end()) {
+                    continue;
+                }
+                Connection& connection = it->second;
+
+                if ((events[i].events & (EPOLLIN | EPOLLRDHUP | EPOLLHUP | EPOLLERR)) && !connection.closing) {
+                    while (!connection.closing) {
+                        const ssize_t received = recv(fd, block.data(), block.size(), 0);
+                        if (received > 0) {
+                            connection.input.append(block.data(), static_cast<size_t>(received));
+                            // Остаток дочитается после разбора уже полученных документов,
+                            // чтобы клиент не мог заставить сервер буферизовать без ограничений
+                            if (connection.input.size() > max_document_size_) {
+                                break;
+                            }
+                            continue;
+                        }
+                        if (received == -1 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+                            break;
+                        }
+                        if (received == -1 && errno == EINTR) {
+                            continue;
+                        }
+                        // Клиент закрыл соединение на запись или произошла ошибка
+                        connection.closing = true;
+                    }
+                    if (binary) {
+                        answer_frames(connection);
+                    }
+                    else {
+                        answer_documents(connection);
+                    }
+                }
+
+                const bool flushed = Flush(connection);
+                if (flushed && connection.closing) {
+                    epoll_ctl(epoll_fd.Get(), EPOLL_CTL_DEL, fd, nullptr);
+                    connections.erase(it);
+                    continue;
+                }
+                // Пока ответы не отправлены, ждём готовности сокета к записи
+                ModifyEpoll(epoll_fd.Get(), fd, flushed ? EPOLLIN | EPOLLRDHUP : EPOLLOUT);
+            }
+        }
+
+        unlink(socket_path_.c_str());
+    }
+
+#else
+
+    void Server::Run() {
+        throw std::runtime_error("Server mode is supported only on Linux");
+    }
+
+#endif
+
+}  // namespace server
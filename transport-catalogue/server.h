@@ -0,0 +1,37 @@
+#pragma once
+
+#include "request_handler.h"
+
+#include <cstddef>
+#include <string>
+
+namespace server {
+
+    // Локальный сервер запросов к уже загруженному справочнику.
+    // Клиент подключается к Unix domain socket и отправляет JSON-документы один за другим:
+    // массив запросов stat_requests или один запрос. На каждый документ сервер отвечает
+    // массивом ответов или одним ответом в том же формате, что и при обработке stdin,
+    // и переводом строки. Соединение может использоваться для любого числа документов.
+    // Если обработчик настроен на Protocol::BINARY, клиент вместо документов отправляет
+    // кадры запросов binary_protocol и получает кадры ответов.
+    // Поддерживается только в Linux (epoll)
+    class Server {
+    public:
+        // Предельный размер одного JSON-документа. Клиент, приславший документ длиннее,
+        // получает сообщение об ошибке, и соединение закрывается
+        static constexpr size_t DEFAULT_MAX_DOCUMENT_SIZE = 16 * 1024 * 1024;
+
+        Server(const request_handler::RequestHandler& handler, std::string socket_path,
+            size_t max_document_size = DEFAULT_MAX_DOCUMENT_SIZE);
+
+        // Обслуживает клиентов до получения SIGINT или SIGTERM.
+        // Ошибки системных вызовов приводят к исключению std::system_error
+        void Run();
+
+    private:
+        const request_handler::RequestHandler& handler_;
+        std::string socket_path_;
+        size_t max_document_size_;
+    };
+
+}  // namespace server
@@ -1,13 +1,22 @@
 #include "svg.h"
+#include "number_format.h"
 
 namespace svg {
 
     using namespace std::literals;
 
+    namespace detail {
+        void WriteNumber(std::ostream& out, double value) {
+            number_format::DoubleBuffer buffer;
+            const std::string_view text = number_format::FormatDouble(value, out.precision(), buffer);
+            out.write(text.data(), static_cast<std::streamsize>(text.size()));
+        }
+    }  // namespace detail
+
     void Object::Render(const RenderContext& context) const {
         context.RenderIndent();
         RenderObject(context);
-        context.out << std::endl;
+        context.out.put('\n');
     }
 
     Circle& Circle::SetCenter(Point center) {
@@ -22,8 +31,13 @@ namespace svg {
 
     void Circle::RenderObject(const RenderContext& context) const {
         auto& out = context.out;
-        out << "<circle cx=\""sv << center_.x << "\" cy=\""sv << center_.y << "\" "sv;
-        out << "r=\""sv << radius_ << "\" "sv;
+        out << "<circle cx=\""sv;
+        detail::WriteNumber(out, center_.x);
+        out << "\" cy=\""sv;
+        detail::WriteNumber(out, center_.y);
+        out << "\" r=\""sv;
+        detail::WriteNumber(out, radius_);
+        out << "\" "sv;
         RenderAttrs(out);
         out << "/>"sv;
     }
@@ -33,18 +47,28 @@ namespace svg {
         return *this;
     }
 
+    Polyline& Polyline::ClearPoints() {
+        points_.clear();
+        return *this;
+    }
+
     void Polyline::RenderObject(const RenderContext& context) const {
         auto& out = context.out;
-        out << "<polyline points=\""sv;
-        bool first = true;
+        // Точек в линии бывают тысячи, поэтому они собираются в буфер,
+        // который переиспользуется между линиями, и выводятся одной записью
+        thread_local std::string points;
+        points.clear();
+        const std::streamsize precision = out.precision();
+        number_format::DoubleBuffer buffer;
         for (const auto& point : points_) {
-            if (!first) {
-                out << " ";
+            if (!points.empty()) {
+                points.push_back(' ');
             }
-            first = false;
-            out << point.x << "," << point.y;
+            points += number_format::FormatDouble(point.x, precision, buffer);
+            points.push_back(',');
+            points += number_format::FormatDouble(point.y, precision, buffer);
         }
-        out << "\"";
+        out << "<polyline points=\""sv << points << "\""sv;
         RenderAttrs(out);
         out << " />"sv;
     }
@@ -74,15 +98,22 @@ namespace svg {
         return *this;
     }
 
-    Text& Text::SetData(std::string data) {
-        data_ = data;
+    Text& Text::SetData(std::string_view data) {
+        data_.assign(data);
         return *this;
     }
 
     void Text::RenderObject(const RenderContext& context) const {
         auto& out = context.out;
-        out << "<text x=\""sv << pos_.x << "\" y=\""sv << pos_.y << "\" "sv;
-        out << "dx=\""sv << offset_.x << "\" dy=\""sv << offset_.y << "\" "sv;
+        out << "<text x=\""sv;
+        detail::WriteNumber(out, pos_.x);
+        out << "\" y=\""sv;
+        detail::WriteNumber(out, pos_.y);
+        out << "\" dx=\""sv;
+        detail::WriteNumber(out, offset_.x);
+        out << "\" dy=\""sv;
+        detail::WriteNumber(out, offset_.y);
+        out << "\" "sv;
         out << "font-size=\""sv << font_size_ << "\""sv;
 
         if (font_family_) {
@@ -105,12 +136,40 @@ namespace svg {
     }
 
     void Document::Render(std::ostream& out) const {
-        out << "<?xml version=\"1.0\" encoding=\"UTF-8\" ?>"sv << std::endl;
-        out << "<svg xmlns=\"http://www.w3.org/2000/svg\" version=\"1.1\">"sv << std::endl;
+        DocumentWriter writer(out);
         for (const auto& obj : objects_) {
-            obj->Render({ out, 2, 2 });
+            writer.Add(*obj);
         }
-        out << "</svg>"sv;
+        writer.Close();
+    }
+
+    DocumentWriter::DocumentWriter(std::ostream& out)
+        : out_(out) {
+        out_ << "<?xml version=\"1.0\" encoding=\"UTF-8\" ?>\n"sv;
+        out_ << "<svg xmlns=\"http://www.w3.org/2000/svg\" version=\"1.1\">\n"sv;
+    }
+
+    DocumentWriter& DocumentWriter::Add(const Object& object) {
+        FragmentWriter(out_).Add(object);
+        return *this;
+    }
+
+    DocumentWriter& DocumentWriter::AddFragment(std::string_view fragment) {
+        out_ << fragment;
+        return *this;
+    }
+
+    void DocumentWriter::Close() {
+        out_ << "</svg>"sv;
+    }
+
+    FragmentWriter::FragmentWriter(std::ostream& out)
+        : out_(out) {
+    }
+
+    FragmentWriter& FragmentWriter::Add(const Object& object) {
+        object.Render({ out_, 2, 2 });
+        return *this;
     }
 
     std::string TagStrokeLineCap(StrokeLineCap line_cap) {
@@ -168,7 +227,9 @@ namespace svg {
     }
     void OstreamColorPrinter::operator()(Rgba color) const {
         out << "rgba("sv << int(color.red) << ","sv << int(color.green)
-            << ","sv << int(color.blue) << ","sv << color.opacity << ")"sv;
+            << ","sv << int(color.blue) << ","sv;
+        detail::WriteNumber(out, color.opacity);
+        out << ")"sv;
     }
 
 }  // namespace svg
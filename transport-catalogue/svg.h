@@ -5,11 +5,17 @@
 #include <memory>
 #include <optional>
 #include <string>
+#include <string_view>
 #include <variant>
 #include <vector>
 
 namespace svg {
 
+    namespace detail {
+        // Выводит число так же, как operator<< (%g с точностью потока), но через std::to_chars
+        void WriteNumber(std::ostream& out, double value);
+    }  // namespace detail
+
     // Цветовые типы
 
     struct Rgb {
@@ -105,7 +111,9 @@ namespace svg {
             }
 
             if (stroke_width_) {
-                out << " stroke-width=\""sv << *stroke_width_ << "\""sv;
+                out << " stroke-width=\""sv;
+                detail::WriteNumber(out, *stroke_width_);
+                out << "\""sv;
             }
 
             if (stroke_line_cap_) {
@@ -190,6 +198,8 @@ namespace svg {
     class Polyline : public Object, public PathProps<Polyline> {
     public:
         Polyline& AddPoint(Point point);
+        // Удаляет точки, сохраняя выделенную под них память
+        Polyline& ClearPoints();
 
     private:
         void RenderObject(const RenderContext& context) const override;
@@ -204,7 +214,8 @@ namespace svg {
         Text& SetFontSize(uint32_t size);
         Text& SetFontFamily(std::string font_family);
         Text& SetFontWeight(std::string font_weight);
-        Text& SetData(std::string data);
+        // Строки копируются в уже выделенную память объекта, если она достаточна
+        Text& SetData(std::string_view data);
 
     private:
         void RenderObject(const RenderContext& context) const override;
@@ -241,6 +252,37 @@ namespace svg {
         std::vector<std::unique_ptr<Object>> objects_;
     };
 
+    // Выводит документ по мере добавления объектов, не сохраняя их. Объект можно
+    // изменить и добавить снова. Результат совпадает с Document::Render для тех же объектов
+    class DocumentWriter {
+    public:
+        // Сразу выводит заголовок документа
+        explicit DocumentWriter(std::ostream& out);
+
+        DocumentWriter& Add(const Object& object);
+
+        // Вставляет объекты, выведенные FragmentWriter
+        DocumentWriter& AddFragment(std::string_view fragment);
+
+        // Завершает документ. Вызывается один раз, после всех Add
+        void Close();
+
+    private:
+        std::ostream& out_;
+    };
+
+    // Выводит объекты так же, как DocumentWriter, но без начала и конца документа.
+    // Так части документа можно построить независимо, например на разных потоках
+    class FragmentWriter {
+    public:
+        explicit FragmentWriter(std::ostream& out);
+
+        FragmentWriter& Add(const Object& object);
+
+    private:
+        std::ostream& out_;
+    };
+
     std::ostream& operator<<(std::ostream& out, StrokeLineCap line_cap);
     std::ostream& operator<<(std::ostream& out, StrokeLineJoin line_join);
 
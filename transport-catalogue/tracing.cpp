@@ -0,0 +1,109 @@
+#include "tracing.h"
+
+#ifdef TRANSPORT_CATALOGUE_TRACING
+
+#include <atomic>
+#include <mutex>
+#include <vector>
+
+#include "json.h"
+
+namespace tracing {
+
+    namespace {
+        using Clock = std::chrono::steady_clock;
+
+        struct Event {
+            std::string_view name;
+            std::string_view category;
+            Clock::time_point start;
+            Clock::duration duration;
+            int thread_id;
+        };
+
+        struct Trace {
+            std::atomic<bool> started = false;
+            std::atomic<bool> with_requests = false;
+            Clock::time_point origin = Clock::now();
+            std::mutex mutex;
+            std::vector<Event> events;
+        };
+
+        Trace& GetTrace() {
+            static Trace trace;
+            return trace;
+        }
+
+        // Короткие номера потоков читаются в просмотрщике лучше, чем std::thread::id
+        int CurrentThreadId() {
+            static std::atomic<int> next_id = 1;
+            thread_local const int id = next_id++;
+            return id;
+        }
+
+        double ToMicroseconds(Clock::duration duration) {
+            return std::chrono::duration<double, std::micro>(duration).count();
+        }
+    }  // namespace
+
+    void Start(bool with_requests) {
+        Trace& trace = GetTrace();
+        trace.with_requests = with_requests;
+        trace.started = true;
+    }
+
+    bool IsStarted() {
+        return GetTrace().started.load(std::memory_order_relaxed);
+    }
+
+    bool RequestSpansEnabled() {
+        const Trace& trace = GetTrace();
+        return trace.started.load(std::memory_order_relaxed) && trace.with_requests.load(std::memory_order_relaxed);
+    }
+
+    void Write(std::ostream& output) {
+        Trace& trace = GetTrace();
+        std::lock_guard lock(trace.mutex);
+
+        // Отметки времени в микросекундах: точности по умолчанию (6 знаков) не хватает
+        const auto precision = output.precision(15);
+        json::Writer writer(output);
+        writer.StartDict()
+            .Key("displayTimeUnit").Value("ms")
+            .Key("traceEvents").StartArray();
+        for (const Event& event : trace.events) {
+            writer.StartDict()
+                .Key("cat").Value(event.category)
+                .Key("dur").Value(ToMicroseconds(event.duration))
+                .Key("name").Value(event.name)
+                .Key("ph").Value("X")
+                .Key("pid").Value(1)
+                .Key("tid").Value(event.thread_id)
+                .Key("ts").Value(ToMicroseconds(event.start - trace.origin))
+                .EndDict();
+        }
+        writer.EndArray().EndDict();
+        output << std::endl;
+        output.precision(precision);
+    }
+
+    Span::Span(std::string_view name, std::string_view category, bool enabled)
+        : name_(name)
+        , category_(category)
+        , enabled_(enabled)
+        , start_(enabled ? Clock::now() : Clock::time_point{}) {
+    }
+
+    Span::~Span() {
+        if (!enabled_) {
+            return;
+        }
+        const auto end = Clock::now();
+        Trace& trace = GetTrace();
+        std::lock_guard lock(trace.mutex);
+        trace.events.push_back({ name_, category_, start_, end - start_, CurrentThreadId() });
+    }
+
+}  // namespace tracing
+
+#endif
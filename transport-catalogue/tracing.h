@@ -0,0 +1,61 @@
+#pragma once
+
+/*
+ * Трассировка фаз работы программы в формате Chrome trace event
+ * (файл открывается в chrome://tracing или ui.perfetto.dev).
+ *
+ * Трассировка собирается только с макросом TRANSPORT_CATALOGUE_TRACING.
+ * Без него TRACE_SCOPE и TRACE_REQUEST_SCOPE раскрываются в пустую инструкцию
+ * и не оставляют в программе ни кода, ни данных
+ */
+
+#ifdef TRANSPORT_CATALOGUE_TRACING
+
+#include <chrono>
+#include <iostream>
+#include <string_view>
+
+namespace tracing {
+
+    // Начинает запись интервалов. До вызова Start интервалы не записываются.
+    // with_requests включает интервалы отдельных запросов (TRACE_REQUEST_SCOPE)
+    void Start(bool with_requests);
+    bool IsStarted();
+    bool RequestSpansEnabled();
+
+    // Записывает накопленные интервалы в формате trace event JSON
+    void Write(std::ostream& output);
+
+    // Интервал от создания до разрушения объекта.
+    // name и category должны жить до вызова Write (обычно это строковые литералы)
+    class Span {
+    public:
+        Span(std::string_view name, std::string_view category, bool enabled = IsStarted());
+        ~Span();
+
+        Span(const Span&) = delete;
+        Span& operator=(const Span&) = delete;
+
+    private:
+        std::string_view name_;
+        std::string_view category_;
+        bool enabled_;
+        std::chrono::steady_clock::time_point start_;
+    };
+
+}  // namespace tracing
+
+#define TRACING_CONCAT_IMPL(a, b) a##b
+#define TRACING_CONCAT(a, b) TRACING_CONCAT_IMPL(a, b)
+
+#define TRACE_SCOPE(name) \
+    const ::tracing::Span TRACING_CONCAT(trace_span_, __LINE__)((name), "phase")
+#define TRACE_REQUEST_SCOPE(name) \
+    const ::tracing::Span TRACING_CONCAT(trace_span_, __LINE__)((name), "request", ::tracing::RequestSpansEnabled())
+
+#else
+
+#define TRACE_SCOPE(name) static_cast<void>(0)
+#define TRACE_REQUEST_SCOPE(name) static_cast<void>(0)
+
+#endif
@@ -20,6 +20,7 @@ namespace transport_catalogue
 
     void TransportCatalogue::AddBus(Bus&& bus) noexcept
     {
+        bus.id = buses_.size();
         buses_.push_back(std::move(bus));
         std::string_view route_name = buses_.back().name;
         buses_by_names_.insert({ route_name, &buses_.back() });
@@ -27,6 +28,7 @@ namespace transport_catalogue
         for (auto stop : buses_.back().stops) {
             buses_on_stops_[stop->name].insert(route_name);
         }
+        ++version_;
     }
 
     int TransportCatalogue::CalculateUniqueStops(const std::vector<const Stop*>& stops_) const
@@ -49,8 +51,10 @@ namespace transport_catalogue
     }
 
     void TransportCatalogue::AddStop(Stop&& stop) noexcept {
+        stop.id = stops_.size();
         stops_.push_back(std::move(stop));
         stops_by_name_.insert({ stops_.back().name, &stops_.back() });
+        ++version_;
     }
 
 
@@ -112,6 +116,16 @@ namespace transport_catalogue
         return result;
     }
 
+    const Stop* TransportCatalogue::GetStop(size_t id) const noexcept
+    {
+        return id < stops_.size() ? &stops_[id] : nullptr;
+    }
+
+    const Bus* TransportCatalogue::GetBus(size_t id) const noexcept
+    {
+        return id < buses_.size() ? &buses_[id] : nullptr;
+    }
+
     const std::set<std::string_view> TransportCatalogue::GetBusesOnStop(const Stop& stop) const
     {
         try
@@ -147,6 +161,7 @@ namespace transport_catalogue
         if (stop_from_ && stop_to_)
         {
             distances_[{stop_from_, stop_to_}] = distance;
+            ++version_;
         }
     }
 
@@ -158,6 +173,11 @@ namespace transport_catalogue
         }
         return result;
     }
+    uint64_t TransportCatalogue::GetVersion() const noexcept
+    {
+        return version_;
+    }
+
     const std::map<std::string_view, const Stop*> TransportCatalogue::GetSortedStops() const
     {
         std::map<std::string_view, const Stop*> result;
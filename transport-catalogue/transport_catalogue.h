@@ -1,4 +1,5 @@
 #pragma once
+#include <cstdint>
 #include <string>
 #include <deque>
 #include <set>
@@ -30,11 +31,19 @@ namespace transport_catalogue
         const BusInfo GetBusInfo(const std::string_view& bus_name) const;
         const Stop* FindStop(const std::string_view& stop_name) const noexcept;
         const Bus* FindBus(const std::string_view& bus_name) const noexcept;
+        // Остановки и маршруты нумеруются с нуля в порядке добавления.
+        // Для неизвестного номера возвращается nullptr
+        const Stop* GetStop(size_t id) const noexcept;
+        const Bus* GetBus(size_t id) const noexcept;
         const std::set<std::string_view> GetBusesOnStop(const Stop& stop) const;
         int GetDistance(const Stop* stop1, const Stop* stop2) const noexcept;
         const std::map<std::string_view, const Bus*> GetSortedBuses() const;
         const std::map<std::string_view, const Stop*> GetSortedStops() const;
 
+        // Версия данных справочника: увеличивается при каждом изменении.
+        // По ней можно проверить, не устарели ли построенные по справочнику кэши
+        uint64_t GetVersion() const noexcept;
+
     private:
         void AddStop(Stop&& stop) noexcept;
         void AddBus(Bus&& bus) noexcept;
@@ -48,6 +57,7 @@ namespace transport_catalogue
         std::unordered_map<std::string_view, const Bus*> buses_by_names_;
         std::unordered_map<std::string_view, std::set<std::string_view>> buses_on_stops_;
         std::unordered_map<std::pair<const Stop*, const Stop*>, int, StopPairHasher> distances_;
+        uint64_t version_ = 0;
     };
 
 }
@@ -1,8 +1,10 @@
 #include "transport_router.h"
+#include "tracing.h"
 
 namespace transport_catalogue {
 
     const graph::DirectedWeightedGraph<double>& Router::BuildGraph(const TransportCatalogue& catalogue) {
+        TRACE_SCOPE("Router::BuildGraph");
         const auto& all_stops = catalogue.GetSortedStops();
         const auto& all_buses = catalogue.GetSortedBuses();
         graph::DirectedWeightedGraph<double> stops_graph(all_stops.size() * 2);
@@ -57,7 +59,11 @@ namespace transport_catalogue {
             });
 
         graph_ = std::move(stops_graph);
-        router_ = std::make_unique<graph::Router<double>>(graph_);
+        {
+            // Предварительный расчёт маршрутов между всеми парами вершин
+            TRACE_SCOPE("graph::Router");
+            router_ = std::make_unique<graph::Router<double>>(graph_);
+        }
 
         return graph_;
     }